@@ -0,0 +1,210 @@
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "Assembler.hpp"
+#include "Batch.hpp"
+#include "Utils.hpp"
+
+static const char USAGE[] = "Usage: DugongBench [--runs=N] [--stream] [--compact | --aligned] [--jobs=N] [--cache] "
+                            "[--optimize] [--fuse] [--container] [--listing] corpus...\n"
+                            "Compiles every corpus into <corpus>.bin N times after a warm-up run.\n";
+
+static const size_t DEFAULT_RUNS = 10;
+
+static const double BYTES_IN_MB = 1024.0 * 1024.0;
+
+/** @struct BenchResult
+ * @brief Times of the runs of a corpus.
+ *
+ * @var BenchResult::mean - mean time of a run in seconds.
+ * @var BenchResult::deviation - standard deviation of the times.
+ * @var BenchResult::min - the fastest run.
+ * @var BenchResult::max - the slowest run.
+ */
+struct BenchResult
+{
+    double mean;
+    double deviation;
+    double min;
+    double max;
+};
+
+static ErrorCode _benchCorpus(const char* corpusPath, const CompileOptions* options, size_t runs, bool writeListing,
+                              BenchResult* result);
+
+static size_t _countLines(const char* path);
+
+static double _now();
+
+int main(int argc, const char* const argv[])
+{
+    CompileOptions options = {};
+    size_t runs = DEFAULT_RUNS;
+    bool writeListing = false;
+
+    const char** corpora = (const char**)calloc((size_t)argc, sizeof(*corpora));
+    size_t corporaCount  = 0;
+
+    if (!corpora)
+        return ERROR_NO_MEMORY;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stream") == 0)
+            options.stream = true;
+        else if (strcmp(argv[i], "--compact") == 0)
+            options.compact = true;
+        else if (strcmp(argv[i], "--aligned") == 0)
+            options.aligned = true;
+        else if (strcmp(argv[i], "--cache") == 0)
+            options.cache = true;
+        else if (strcmp(argv[i], "--optimize") == 0)
+            options.optimize = true;
+        else if (strcmp(argv[i], "--fuse") == 0)
+        {
+            options.optimize = true;
+            options.fuse     = true;
+        }
+        else if (strcmp(argv[i], "--container") == 0)
+            options.container = true;
+        else if (strcmp(argv[i], "--listing") == 0)
+            writeListing = true;
+        else if (strncmp(argv[i], "--jobs=", sizeof("--jobs=") - 1) == 0)
+            options.jobs = strtoul(argv[i] + sizeof("--jobs=") - 1, NULL, 10);
+        else if (strncmp(argv[i], "--runs=", sizeof("--runs=") - 1) == 0)
+            runs = strtoul(argv[i] + sizeof("--runs=") - 1, NULL, 10);
+        else if (strncmp(argv[i], "--", 2) == 0)
+        {
+            fprintf(stderr, "Unknown option %s.\n%s", argv[i], USAGE);
+            free(corpora);
+            return ERROR_BAD_VALUE;
+        }
+        else
+            corpora[corporaCount++] = argv[i];
+    }
+
+    if (corporaCount == 0 || runs == 0)
+    {
+        fprintf(stderr, "Please, give corpora and a positive number of runs.\n%s", USAGE);
+        free(corpora);
+        return ERROR_BAD_VALUE;
+    }
+
+    if (options.stream && (options.optimize || options.container))
+    {
+        fprintf(stderr, "Stream mode only writes plain byte code.\n%s", USAGE);
+        free(corpora);
+        return ERROR_BAD_VALUE;
+    }
+
+    printf("%-32s %10s %8s %5s %10s %10s %10s %10s %12s %8s\n",
+           "corpus", "lines", "MB", "runs", "mean ms", "stddev ms", "min ms", "max ms", "lines/s", "MB/s");
+
+    ErrorCode error = EVERYTHING_FINE;
+
+    for (size_t i = 0; i < corporaCount && !error; i++)
+    {
+        BenchResult result = {};
+        error = _benchCorpus(corpora[i], &options, runs, writeListing, &result);
+
+        if (error)
+        {
+            printf("BENCH ERROR %s in %s!!!\n", ERROR_CODE_NAMES[error], corpora[i]);
+            break;
+        }
+
+        double lines = (double)_countLines(corpora[i]);
+        double mb    = (double)GetFileSize(corpora[i]) / BYTES_IN_MB;
+
+        printf("%-32s %10.0f %8.2f %5zu %10.2f %10.2f %10.2f %10.2f %12.0f %8.2f\n",
+               corpora[i], lines, mb, runs, result.mean * 1000, result.deviation * 1000,
+               result.min * 1000, result.max * 1000, lines / result.mean, mb / result.mean);
+    }
+
+    // the peak of the whole process, so it is the peak of the largest corpus
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("peak RSS: %ld KB\n", usage.ru_maxrss);
+
+    free(corpora);
+
+    return error;
+}
+
+static ErrorCode _benchCorpus(const char* corpusPath, const CompileOptions* options, size_t runs, bool writeListing,
+                              BenchResult* result)
+{
+    char* binaryPath = (char*)calloc(strlen(corpusPath) + sizeof(".bin"), sizeof(*binaryPath));
+    MyAssertSoft(binaryPath, ERROR_NO_MEMORY);
+
+    strcpy(binaryPath, corpusPath);
+    strcat(binaryPath, ".bin");
+
+    char* listingPath = writeListing ? CreateListingPath(binaryPath) : NULL;
+    MyAssertSoft(listingPath || !writeListing, ERROR_NO_MEMORY, free(binaryPath));
+
+    double* times = (double*)calloc(runs, sizeof(*times));
+    MyAssertSoft(times, ERROR_NO_MEMORY, free(binaryPath); free(listingPath));
+
+    // the first run brings the corpus into the page cache
+    ErrorCode error = Compile(corpusPath, binaryPath, listingPath, options);
+
+    for (size_t i = 0; i < runs && !error; i++)
+    {
+        double start = _now();
+        error = Compile(corpusPath, binaryPath, listingPath, options);
+        times[i] = _now() - start;
+    }
+
+    if (!error)
+    {
+        *result = {0, 0, times[0], times[0]};
+
+        for (size_t i = 0; i < runs; i++)
+        {
+            result->mean += times[i] / (double)runs;
+            result->min   = times[i] < result->min ? times[i] : result->min;
+            result->max   = times[i] > result->max ? times[i] : result->max;
+        }
+
+        for (size_t i = 0; i < runs; i++)
+            result->deviation += (times[i] - result->mean) * (times[i] - result->mean) / (double)runs;
+
+        result->deviation = sqrt(result->deviation);
+    }
+
+    free(times);
+    free(binaryPath);
+    free(listingPath);
+
+    return error;
+}
+
+static size_t _countLines(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    char   buffer[1 << 16] = {};
+    size_t lines = 0;
+    size_t read  = 0;
+
+    while ((read = fread(buffer, sizeof(*buffer), sizeof(buffer), file)) != 0)
+        for (size_t i = 0; i < read; i++)
+            lines += buffer[i] == '\n';
+
+    fclose(file);
+
+    return lines;
+}
+
+static double _now()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+static const char USAGE[] = "Usage: DugongCorpus [--lines=N] [--labels=R] [--forward=R] [--comments=R] "
+                            "[--ram=R] [--registers=R] [--seed=N]\n"
+                            "Writes a synthetic assembly source to stdout, R are ratios from 0 to 1.\n";
+
+// forward references point at most this many labels ahead, so they get defined soon
+static const uint64_t FORWARD_WINDOW = 64;
+
+static const char* const REGISTERS[] = {"rax", "rbx", "rcx", "rdx"};
+static const char* const JUMPS[]     = {"jmp", "ja", "jae", "jb", "jbe", "je", "jne", "call"};
+static const char* const NO_ARG[]    = {"add", "sub", "mul", "div", "sqrt", "sin", "cos", "flr", "ceil", "out", "ret"};
+static const char* const COMMENTS[]  = {"loop counter", "keep the result", "next element", "TODO: unroll",
+                                        "swap the operands"};
+
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
+/** @struct CorpusOptions
+ * @brief What a corpus looks like.
+ *
+ * @var CorpusOptions::lines - number of lines.
+ * @var CorpusOptions::labels - share of lines which define labels, as many commands reference labels.
+ * @var CorpusOptions::forward - share of label references which point to labels defined later.
+ * @var CorpusOptions::comments - share of lines with a comment, half of them are whole line comments.
+ * @var CorpusOptions::ram - share of push and pop operands which are RAM cells.
+ * @var CorpusOptions::registers - share of push and pop operands which are registers.
+ * @var CorpusOptions::seed - seed of the generator, the same options give the same corpus.
+ */
+struct CorpusOptions
+{
+    size_t lines;
+    double labels;
+    double forward;
+    double comments;
+    double ram;
+    double registers;
+    uint64_t seed;
+};
+
+static void _writeCorpus(const CorpusOptions* options, FILE* file);
+
+static void _writeOperand(uint64_t* random, const CorpusOptions* options, bool isPop, FILE* file);
+
+static void _writeNumber(uint64_t* random, FILE* file);
+
+static bool _parseRatio(const char* arg, const char* option, double* ratio);
+
+static uint64_t _random(uint64_t* state);
+
+static double _randomRatio(uint64_t* state);
+
+int main(int argc, const char* const argv[])
+{
+    CorpusOptions options = {100000, 0.05, 0.5, 0.1, 0.2, 0.4, 1};
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool isKnown = _parseRatio(argv[i], "--labels=",    &options.labels)   ||
+                       _parseRatio(argv[i], "--forward=",   &options.forward)  ||
+                       _parseRatio(argv[i], "--comments=",  &options.comments) ||
+                       _parseRatio(argv[i], "--ram=",       &options.ram)      ||
+                       _parseRatio(argv[i], "--registers=", &options.registers);
+
+        if (strncmp(argv[i], "--lines=", sizeof("--lines=") - 1) == 0)
+        {
+            options.lines = strtoul(argv[i] + sizeof("--lines=") - 1, NULL, 10);
+            isKnown = true;
+        }
+        else if (strncmp(argv[i], "--seed=", sizeof("--seed=") - 1) == 0)
+        {
+            options.seed = strtoull(argv[i] + sizeof("--seed=") - 1, NULL, 10);
+            isKnown = true;
+        }
+
+        if (!isKnown)
+        {
+            fprintf(stderr, "Unknown option %s.\n%s", argv[i], USAGE);
+            return 1;
+        }
+    }
+
+    if (options.ram + options.registers > 1)
+    {
+        fprintf(stderr, "RAM and register operands take more than all of them.\n%s", USAGE);
+        return 1;
+    }
+
+    _writeCorpus(&options, stdout);
+
+    return ferror(stdout) ? 1 : 0;
+}
+
+static void _writeCorpus(const CorpusOptions* options, FILE* file)
+{
+    // xorshift gets stuck at 0
+    uint64_t random = options->seed ? options->seed : 1;
+
+    uint64_t definedLabels  = 0;
+    uint64_t referredLabels = 0;
+
+    for (size_t line = 0; line < options->lines; line++)
+    {
+        if (_randomRatio(&random) < options->labels)
+        {
+            fprintf(file, "L%" PRIu64 ":\n", definedLabels++);
+            continue;
+        }
+
+        bool hasComment = _randomRatio(&random) < options->comments;
+        if (hasComment && _random(&random) % 2 == 0)
+        {
+            fprintf(file, "; %s\n", COMMENTS[_random(&random) % ARRAY_SIZE(COMMENTS)]);
+            continue;
+        }
+
+        double command = _randomRatio(&random);
+
+        if (command < options->labels)
+        {
+            uint64_t label = 0;
+            if (definedLabels == 0 || _randomRatio(&random) < options->forward)
+                label = definedLabels + 1 + _random(&random) % FORWARD_WINDOW;
+            else
+                label = _random(&random) % definedLabels;
+
+            if (label >= referredLabels)
+                referredLabels = label + 1;
+
+            fprintf(file, "%s L%" PRIu64, JUMPS[_random(&random) % ARRAY_SIZE(JUMPS)], label);
+        }
+        else if (command < 0.5)
+        {
+            fprintf(file, "push ");
+            _writeOperand(&random, options, false, file);
+        }
+        else if (command < 0.7)
+        {
+            fprintf(file, "pop ");
+            _writeOperand(&random, options, true, file);
+        }
+        else
+            fprintf(file, "%s", NO_ARG[_random(&random) % ARRAY_SIZE(NO_ARG)]);
+
+        if (hasComment)
+            fprintf(file, " ; %s", COMMENTS[_random(&random) % ARRAY_SIZE(COMMENTS)]);
+
+        fputc('\n', file);
+    }
+
+    // every forward reference gets its label
+    for (uint64_t label = definedLabels; label < referredLabels; label++)
+        fprintf(file, "L%" PRIu64 ":\n", label);
+}
+
+static void _writeOperand(uint64_t* random, const CorpusOptions* options, bool isPop, FILE* file)
+{
+    double      kind    = _randomRatio(random);
+    const char* reg     = REGISTERS[_random(random) % ARRAY_SIZE(REGISTERS)];
+    uint64_t    variant = _random(random) % 3;
+
+    if (kind < options->ram)
+    {
+        fputc('[', file);
+
+        if (variant == 0)
+            fprintf(file, "%" PRIu64, _random(random) % 100);
+        else if (variant == 1)
+            fprintf(file, "%s", reg);
+        else
+            fprintf(file, "%s+%" PRIu64, reg, _random(random) % 100);
+
+        fputc(']', file);
+    }
+    // pop writes to its operand, so it takes only registers besides RAM
+    else if (kind < options->ram + options->registers || isPop)
+    {
+        if (variant == 0 && !isPop)
+            fprintf(file, "%s+%" PRIu64, reg, _random(random) % 100);
+        else
+            fprintf(file, "%s", reg);
+    }
+    else
+        _writeNumber(random, file);
+}
+
+static void _writeNumber(uint64_t* random, FILE* file)
+{
+    switch (_random(random) % 4)
+    {
+        case 0:
+            fprintf(file, "%" PRIu64, _random(random) % 10);
+            break;
+        case 1:
+            fprintf(file, "-%" PRIu64, _random(random) % 1000);
+            break;
+        case 2:
+            fprintf(file, "%" PRIu64 ".%03" PRIu64, _random(random) % 1000, _random(random) % 1000);
+            break;
+        default:
+            fprintf(file, "%" PRIu64 "e-%" PRIu64, _random(random) % 100000, _random(random) % 10);
+            break;
+    }
+}
+
+static bool _parseRatio(const char* arg, const char* option, double* ratio)
+{
+    size_t optionLength = strlen(option);
+    if (strncmp(arg, option, optionLength) != 0)
+        return false;
+
+    char*  end   = NULL;
+    double value = strtod(arg + optionLength, &end);
+
+    if (*end != '\0' || !(0 <= value && value <= 1))
+        return false;
+
+    *ratio = value;
+
+    return true;
+}
+
+static uint64_t _random(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+static double _randomRatio(uint64_t* state)
+{
+    return (double)(_random(state) >> 11) / (double)(1ULL << 53);
+}
@@ -0,0 +1,31 @@
+//! @file
+
+#ifndef AOT_HPP
+#define AOT_HPP
+
+#include "Spu.hpp"
+
+/**
+ * @brief Writes a loaded program as a C++ translation unit with a labeled block per command.
+ * Blocks run the bodies from Commands.gen on local stacks, registers and RAM, fall through to the next command
+ * and jump straight to immediate targets. Calls and returns use a stack of label addresses.
+ *
+ * @param [in] program - the program.
+ * @param [in] file - where to write.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode SpuProgramWriteAot(const SpuProgram* program, FILE* file);
+
+/**
+ * @brief Translates a loaded program with @see SpuProgramWriteAot into outputPath.cpp
+ * and compiles it into an executable with the system compiler at -O2, $CXX if it is set.
+ *
+ * @param [in] program - the program.
+ * @param [in] outputPath - the executable.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode SpuProgramCompileAot(const SpuProgram* program, const char* outputPath);
+
+#endif
@@ -0,0 +1,81 @@
+//! @file
+//! Included by programs which @see SpuProgramCompileAot translates into C++.
+
+#ifndef AOT_RUNTIME_HPP
+#define AOT_RUNTIME_HPP
+
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "SpuCommands.hpp"
+
+// every body of Commands.gen becomes a function which is inlined into the labeled block of each command
+#define DEF_COMMAND(name, num, hasArg, ...)                                                 \
+static inline __attribute__((always_inline)) ErrorCode AOT_ ## name(Spu* spu, ArgResult argResult) \
+{                                                                                           \
+    (void)spu;                                                                              \
+    (void)argResult;                                                                        \
+                                                                                            \
+    __VA_ARGS__                                                                             \
+    return EVERYTHING_FINE;                                                                 \
+}
+
+#include "Commands.gen"
+
+#undef DEF_COMMAND
+
+/**
+ * @brief Translated program.
+ *
+ * @param [in] stackData - SPU_STACK_CAPACITY elements for the data stack.
+ * @param [in] ram - SPU_RAM_SIZE cells of memory.
+ * @param [in] returnStack - SPU_STACK_CAPACITY return addresses for calls.
+ *
+ * @return ErrorCode of the failed command.
+ */
+typedef ErrorCode (*AotProgram)(double* stackData, double* ram, const void** returnStack);
+
+/**
+ * @brief Makes a double of its bits, for immediates which have no literal.
+ *
+ * @param [in] bits - the bits.
+ *
+ * @return the double.
+ */
+static inline double AotDouble(uint64_t bits)
+{
+    double value = 0;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+/**
+ * @brief Runs a translated program like DugongSPU runs the byte code.
+ *
+ * @param [in] program - the program.
+ *
+ * @return ErrorCode of the failed command, the exit code.
+ */
+static inline int AotMain(AotProgram program)
+{
+    double*      stackData   = (double*)     calloc(SPU_STACK_CAPACITY, sizeof(*stackData));
+    double*      ram         = (double*)     calloc(SPU_RAM_SIZE, sizeof(*ram));
+    const void** returnStack = (const void**)calloc(SPU_STACK_CAPACITY, sizeof(*returnStack));
+
+    ErrorCode error = stackData && ram && returnStack ? EVERYTHING_FINE : ERROR_NO_MEMORY;
+
+    if (!error)
+        error = program(stackData, ram, returnStack);
+
+    if (error)
+        printf("SPU ERROR %s!!!\n", ERROR_CODE_NAMES[error]);
+
+    free(stackData);
+    free(ram);
+    free(returnStack);
+
+    return error;
+}
+
+#endif
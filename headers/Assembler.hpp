@@ -1,5 +1,64 @@
+//! @file
+
+#ifndef ASSEMBLER_HPP
+#define ASSEMBLER_HPP
+
 #include "Utils.hpp"
+#include "CompileStats.hpp"
 
 typedef unsigned int uint;
 
-ErrorCode Compile(const char* codeFilePath, const char* byteCodeFilePath, const char* listingFilePath);
+/** @struct CompileOptions
+ * @brief Settings of @see Compile.
+ *
+ * @var CompileOptions::stream - read the source in chunks and write the code as it is emitted,
+ *                               memory is bounded by labels and pending fixups instead of the source size.
+ * @var CompileOptions::compact - store immediates in the smallest exact width, @see FORMAT_COMPACT.
+ * @var CompileOptions::aligned - write fixed size records which jumps address by index, @see FORMAT_ALIGNED.
+ *                               Overrides compact.
+ * @var CompileOptions::jobs - number of threads assembling parts of the source, 0 or 1 for a single thread.
+ *                             Ignored in stream mode.
+ * @var CompileOptions::cache - keep assembled blocks of the source in <byte code file>.cache
+ *                              and reassemble only blocks which changed since the last compilation.
+ *                              Ignored in stream mode.
+ * @var CompileOptions::object - write a relocatable object for @see Link instead of byte code,
+ *                               labels which the source doesn't define are imported. Not with stream mode.
+ * @var CompileOptions::optimize - run the peephole and block layout passes @see OptimizeCode
+ *                                 before labels are resolved. Not with stream mode.
+ * @var CompileOptions::fuse - replace pairs of commands with fused ones while optimizing,
+ *                             the code needs an SPU of command set version 15.
+ * @var CompileOptions::container - write the byte code as an executable @see WriteExecutable
+ *                                  with the labels as its symbols. Ignored for objects, not with stream mode.
+ * @var CompileOptions::diagnostics - where errors in the source are reported, NULL for stdout.
+ * @var CompileOptions::stats - where to put timings of phases and counters, NULL to not collect them.
+ */
+struct CompileOptions
+{
+    bool stream;
+    bool compact;
+    bool aligned;
+    size_t jobs;
+    bool cache;
+    bool object;
+    bool optimize;
+    bool fuse;
+    bool container;
+    FILE* diagnostics;
+    CompileStats* stats;
+};
+
+/**
+ * @brief Compiles assembly code into byte code.
+ * Keeps no state between calls, so files can be compiled on different threads at once.
+ *
+ * @param [in] codeFilePath - the source.
+ * @param [in] byteCodeFilePath - where to write the byte code.
+ * @param [in] listingFilePath - where to write the listing, NULL for no listing.
+ * @param [in] options - settings, NULL for default ones.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode Compile(const char* codeFilePath, const char* byteCodeFilePath, const char* listingFilePath,
+                  const CompileOptions* options);
+
+#endif
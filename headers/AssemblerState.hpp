@@ -0,0 +1,188 @@
+//! @file
+
+#ifndef ASSEMBLER_STATE_HPP
+#define ASSEMBLER_STATE_HPP
+
+#include "Utils.hpp"
+#include "LabelTable.hpp"
+#include "Commands.hpp"
+#include "Bytecode.hpp"
+#include "CompileStats.hpp"
+
+/** @struct Fixup
+ * @brief Reference to a label which was not defined when the immediate was emitted.
+ *
+ * @var Fixup::codePosition - where the immediate to patch is.
+ * @var Fixup::labelIndex - index of the label in the label table.
+ * @var Fixup::tokenIndex - line of the reference for error messages.
+ * @var Fixup::width - how the immediate is stored.
+ */
+struct Fixup
+{
+    size_t codePosition;
+    size_t labelIndex;
+    size_t tokenIndex;
+    ImmediateWidth width;
+};
+
+/** @struct ListingLine
+ * @brief Line which gets to the listing once the code is final.
+ *
+ * @var ListingLine::tokenIndex - line in the source.
+ * @var ListingLine::codePosition - where the command starts.
+ * @var ListingLine::commandInfo - the command or NULL for labels.
+ */
+struct ListingLine
+{
+    size_t tokenIndex;
+    size_t codePosition;
+    const CommandInfo* commandInfo;
+};
+
+/** @struct CodeIr
+ * @brief Commands of the code in parallel arrays, filled once while the source is parsed,
+ * so passes over the code sweep them instead of decoding it.
+ *
+ * @var CodeIr::commands - numbers of the commands.
+ * @var CodeIr::argTypes - @see ArgType bits.
+ * @var CodeIr::regNums - registers.
+ * @var CodeIr::widths - @see ImmediateWidth of the immediates.
+ * @var CodeIr::sizes - sizes of the encoded commands, the first one starts at 0.
+ * @var CodeIr::fixupsCounts - fixups of the immediates, they are in the order of the commands.
+ * @var CodeIr::immeds - immediates without labels which are added by fixups.
+ * @var CodeIr::count - number of commands.
+ * @var CodeIr::capacity - size of every array.
+ */
+struct CodeIr
+{
+    byte*   commands;
+    byte*   argTypes;
+    byte*   regNums;
+    byte*   widths;
+    byte*   sizes;
+    byte*   fixupsCounts;
+    double* immeds;
+    size_t  count;
+    size_t  capacity;
+};
+
+/** @struct AssemblerState
+ * @brief Everything the assembler builds while going through the source.
+ *
+ * @var AssemblerState::codeArray - emitted code which was not written yet.
+ * @var AssemblerState::codeCapacity - size of codeArray.
+ * @var AssemblerState::codeBase - code position of codeArray[0], moves when the stream is flushed.
+ * @var AssemblerState::codePosition - where the next command goes.
+ * @var AssemblerState::flushedFixups - number of fixups which immediates are already written.
+ * @var AssemblerState::format - how commands are encoded.
+ * @var AssemblerState::deferLabels - turn every label reference into a fixup, even to defined labels.
+ * @var AssemblerState::writeListing - whether listing lines are collected.
+ * @var AssemblerState::collectIr - whether commands are kept in ir.
+ * @var AssemblerState::errorLine - line where assembling stopped with an error.
+ * @var AssemblerState::diagnostics - where errors in the source are reported.
+ * @var AssemblerState::stats - where phases are timed, NULL if they are not.
+ * @var AssemblerState::commandsCount - commands assembled into the state.
+ * @var AssemblerState::allocations - arrays grown for the state on threads other than the one which owns it.
+ */
+struct AssemblerState
+{
+    CodeFormat format;
+    bool       deferLabels;
+    bool       writeListing;
+    bool       collectIr;
+    size_t     errorLine;
+    FILE*      diagnostics;
+
+    CompileStats* stats;
+    size_t        commandsCount;
+    size_t        allocations;
+
+    byte*  codeArray;
+    size_t codeCapacity;
+    size_t codeBase;
+    size_t codePosition;
+
+    LabelTable labels;
+
+    Fixup* fixups;
+    size_t fixupsCount;
+    size_t fixupsCapacity;
+    size_t flushedFixups;
+
+    ListingLine* listing;
+    size_t       listingCount;
+    size_t       listingCapacity;
+
+    CodeIr ir;
+};
+
+/**
+ * @brief Grows an array to fit size elements doubling its capacity.
+ *
+ * @param [in, out] array - the array.
+ * @param [in, out] capacity - its capacity.
+ * @param [in] size - how many elements must fit.
+ * @param [in] elementSize - size of an element.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode GrowArray(void** array, size_t* capacity, size_t size, size_t elementSize);
+
+/**
+ * @brief Number of times @see GrowArray reallocated an array on the calling thread.
+ *
+ * @return the number.
+ */
+size_t GrowArrayCount();
+
+/**
+ * @brief Makes room for count commands in every array of an IR.
+ *
+ * @param [in, out] ir - the IR.
+ * @param [in] count - how many commands it must fit.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode CodeIrReserve(CodeIr* ir, size_t count);
+
+/**
+ * @brief Appends a command to an IR.
+ *
+ * @param [in, out] ir - the IR.
+ * @param [in] instruction - the command with its size.
+ * @param [in] fixupsCount - number of fixups of its immediate.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode CodeIrAppend(CodeIr* ir, const Instruction* instruction, size_t fixupsCount);
+
+/**
+ * @brief Fills the IR of a state which was read in the encoded form.
+ *
+ * @param [in, out] state - the state.
+ *
+ * @return ErrorCode, ERROR_BAD_SIZE if the code can't be decoded.
+ */
+ErrorCode BuildCodeIr(AssemblerState* state);
+
+/**
+ * @brief Frees all memory of a state.
+ *
+ * @param [in] state - the state to destroy.
+ */
+void DestroyAssemblerState(AssemblerState* state);
+
+/**
+ * @brief Appends a part assembled with deferred labels to the end of a state.
+ * Code, label positions, fixups, listing lines and the IR of the part are moved to the end of the state's code,
+ * labels are merged by name keeping the order of their first appearance, the first definition wins.
+ *
+ * @param [in, out] state - where to append.
+ * @param [in] part - what to append, its code starts at 0.
+ * @param [in] firstLine - line of the part's first line in the source.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode MergeAssemblerState(AssemblerState* state, const AssemblerState* part, size_t firstLine);
+
+#endif
@@ -0,0 +1,108 @@
+//! @file
+
+#ifndef ASSEMBLY_CACHE_HPP
+#define ASSEMBLY_CACHE_HPP
+
+#include "AssemblerState.hpp"
+#include "OutputBuffer.hpp"
+
+/** @struct AssemblyCache
+ * @brief Blocks assembled by the previous compilation, found by hashes of their source.
+ *
+ * @var AssemblyCache::data - mapped cache file.
+ * @var AssemblyCache::size - its size.
+ * @var AssemblyCache::hashes - hash of the entry in every slot, slots are probed linearly.
+ * @var AssemblyCache::offsets - offset of the entry's block in data, 0 for empty slots.
+ * @var AssemblyCache::sizes - size of the entry's block.
+ * @var AssemblyCache::slotsCount - number of slots, a power of two.
+ */
+struct AssemblyCache
+{
+    const byte* data;
+    size_t      size;
+
+    uint64_t* hashes;
+    size_t*   offsets;
+    size_t*   sizes;
+    size_t    slotsCount;
+};
+
+/** @struct AssemblyCacheWriter
+ * @brief Writes a new cache next to the old one and replaces it when all blocks are written.
+ *
+ * @var AssemblyCacheWriter::path - the cache.
+ * @var AssemblyCacheWriter::tempPath - where the new cache is written.
+ * @var AssemblyCacheWriter::file - the new cache.
+ * @var AssemblyCacheWriter::output - buffer of the new cache.
+ * @var AssemblyCacheWriter::entriesCount - number of written blocks.
+ */
+struct AssemblyCacheWriter
+{
+    const char*  path;
+    char*        tempPath;
+    FILE*        file;
+    OutputBuffer output;
+    size_t       entriesCount;
+};
+
+/**
+ * @brief Maps a cache and indexes its blocks.
+ * Missing caches, caches of another format and broken caches are opened empty.
+ *
+ * @param [out] cache - the cache.
+ * @param [in] path - the cache file.
+ * @param [in] format - format of code the blocks must have.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode AssemblyCacheOpen(AssemblyCache* cache, const char* path, CodeFormat format);
+
+/**
+ * @brief Finds a block.
+ *
+ * @param [in] cache - the cache.
+ * @param [in] hash - hash of the block's source.
+ * @param [out] size - size of the block.
+ *
+ * @return the serialized block @see ReadAssembledBlock or NULL if it is not cached.
+ */
+const byte* AssemblyCacheFind(const AssemblyCache* cache, uint64_t hash, size_t* size);
+
+/**
+ * @brief Unmaps a cache, blocks read from it become invalid.
+ */
+void AssemblyCacheClose(AssemblyCache* cache);
+
+/**
+ * @brief Starts a new cache.
+ *
+ * @param [out] writer - the writer.
+ * @param [in] path - the cache file, must outlive the writer.
+ * @param [in] format - format of the blocks.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode AssemblyCacheWriterOpen(AssemblyCacheWriter* writer, const char* path, CodeFormat format);
+
+/**
+ * @brief Adds a block to the new cache.
+ *
+ * @param [in, out] writer - the writer.
+ * @param [in] hash - hash of the block's source.
+ * @param [in] block - the block @see WriteAssembledBlock.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode AssemblyCacheWriterAdd(AssemblyCacheWriter* writer, uint64_t hash, const AssemblerState* block);
+
+/**
+ * @brief Finishes the new cache.
+ *
+ * @param [in] writer - the writer.
+ * @param [in] commit - replace the old cache with the new one or drop the new one.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode AssemblyCacheWriterClose(AssemblyCacheWriter* writer, bool commit);
+
+#endif
@@ -0,0 +1,30 @@
+//! @file
+
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "Assembler.hpp"
+
+/**
+ * @brief Makes the path of the listing for a byte code file: "<byteCodeFilePath>_listing.txt".
+ *
+ * @param [in] byteCodeFilePath - the byte code file.
+ *
+ * @return the path which must be freed or NULL if there is no memory.
+ */
+char* CreateListingPath(const char* byteCodeFilePath);
+
+/**
+ * @brief Compiles all files of a manifest on a pool of threads.
+ * Every line of the manifest is "input output", empty lines are skipped.
+ * Errors of every file are printed to stdout in the order of the manifest once all files are done.
+ *
+ * @param [in] manifestPath - the manifest.
+ * @param [in] options - settings of every file, jobs is the number of threads in the pool, 0 for one per core.
+ * @param [in] writeListing - whether listings are written next to byte code files.
+ *
+ * @return ErrorCode of the first failed file.
+ */
+ErrorCode CompileBatch(const char* manifestPath, const CompileOptions* options, bool writeListing);
+
+#endif
@@ -0,0 +1,146 @@
+//! @file
+
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include "Utils.hpp"
+#include "Commands.hpp"
+
+typedef unsigned char byte;
+#include "SPUsettings.ini"
+
+/** @enum CodeFormat
+ * @brief How commands are laid out in the byte code.
+ *
+ * @var CodeFormat::FORMAT_PLAIN - command byte, 8 byte double immediate, register byte.
+ * @var CodeFormat::FORMAT_COMPACT - command byte, then if there is an immediate
+ *                                   a descriptor byte (width << 4 | register) and the immediate
+ *                                   of the width, otherwise a register byte.
+ * @var CodeFormat::FORMAT_ALIGNED - ALIGNED_INSTRUCTION_SIZE byte records of command byte, @see ArgType byte,
+ *                                   register byte, padding and a double immediate aligned to 8 bytes.
+ *                                   Positions in the code are counted in commands, so they index the records.
+ */
+enum CodeFormat
+{
+    FORMAT_PLAIN,
+    FORMAT_COMPACT,
+    FORMAT_ALIGNED,
+};
+
+/** @enum ImmediateWidth
+ * @brief How an immediate is stored in compact code.
+ */
+enum ImmediateWidth
+{
+    IMMEDIATE_INT8,
+    IMMEDIATE_INT16,
+    IMMEDIATE_INT32,
+    IMMEDIATE_FLOAT32,
+    IMMEDIATE_DOUBLE,
+};
+
+static const size_t ALIGNED_INSTRUCTION_SIZE = 16;
+static const size_t ALIGNED_IMMEDIATE_OFFSET = 8;
+
+static const size_t MAX_INSTRUCTION_SIZE = ALIGNED_INSTRUCTION_SIZE;
+
+static const byte COMMAND_MASK    = (1 << BITS_FOR_COMMAND) - 1;
+static const byte REG_NUM_MASK    = 0x0F;
+static const int  WIDTH_SHIFT     = 4;
+
+/** @struct Instruction
+ * @brief Decoded command.
+ *
+ * @var Instruction::command - command's number.
+ * @var Instruction::argType - @see ArgType bits.
+ * @var Instruction::regNum - register if argType has RegisterArg.
+ * @var Instruction::immed - immediate if argType has ImmediateNumberArg.
+ * @var Instruction::width - how the immediate is stored.
+ * @var Instruction::size - size of the encoded command.
+ */
+struct Instruction
+{
+    byte command;
+    byte argType;
+    byte regNum;
+    double immed;
+    ImmediateWidth width;
+    size_t size;
+};
+
+struct InstructionResult
+{
+    Instruction value;
+    ErrorCode error;
+};
+
+/**
+ * @brief Chooses the smallest width which keeps the immediate exact.
+ * Immediates with labels always get int32 or double, so the width doesn't depend on
+ * whether the labels were known when the command was emitted.
+ *
+ * @param [in] immed - the immediate.
+ * @param [in] hasLabel - whether the immediate references labels.
+ *
+ * @return width.
+ */
+ImmediateWidth ChooseImmediateWidth(double immed, bool hasLabel);
+
+/**
+ * @brief Size of an immediate of the width in the format.
+ */
+size_t ImmediateSize(ImmediateWidth width, CodeFormat format);
+
+/**
+ * @brief How many bytes of the code a unit of positions which commands jump to takes,
+ * positions of labels in the assembler are kept in bytes and are divided by it when they become immediates.
+ */
+size_t CodeUnitSize(CodeFormat format);
+
+/**
+ * @brief Encodes a command.
+ *
+ * @param [out] code - where to write, at least MAX_INSTRUCTION_SIZE bytes.
+ * @param [in] instruction - what to write, size is ignored.
+ * @param [in] format - how to write.
+ * @param [out] immedOffset - where the immediate is from the start of the command, may be NULL.
+ *
+ * @return size of the encoded command.
+ */
+size_t EncodeInstruction(byte* code, const Instruction* instruction, CodeFormat format, size_t* immedOffset);
+
+/**
+ * @brief Decodes a command.
+ *
+ * @param [in] code - start of the command.
+ * @param [in] codeSize - how many bytes are left in the code.
+ * @param [in] format - how the code is written.
+ *
+ * @return the command.
+ */
+InstructionResult DecodeInstruction(const byte* code, size_t codeSize, CodeFormat format);
+
+/**
+ * @brief Reads an immediate.
+ *
+ * @param [in] immediate - where it is.
+ * @param [in] width - how it is stored.
+ * @param [in] format - how the code is written.
+ *
+ * @return the immediate.
+ */
+double ReadImmediate(const byte* immediate, ImmediateWidth width, CodeFormat format);
+
+/**
+ * @brief Adds delta to an immediate in place.
+ *
+ * @param [in, out] immediate - where it is.
+ * @param [in] width - how it is stored.
+ * @param [in] format - how the code is written.
+ * @param [in] delta - what to add.
+ *
+ * @return ERROR_BAD_VALUE if the sum doesn't fit the width.
+ */
+ErrorCode PatchImmediate(byte* immediate, ImmediateWidth width, CodeFormat format, double delta);
+
+#endif
@@ -0,0 +1,215 @@
+//! @file
+
+#ifndef COMMANDS_HPP
+#define COMMANDS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const size_t MAX_COMMAND_LENGTH = 4;
+
+enum Command
+{
+    #define DEF_COMMAND(name, num, ...) \
+        CMD_ ## name = num,
+
+    #include "Commands.gen"
+
+    #undef DEF_COMMAND
+};
+
+// defined at the top of Commands.gen, so the version changes together with the commands
+static const uint32_t COMMAND_SET_VERSION = COMMAND_SET_VERSION_NUMBER;
+
+/** @struct CommandInfo
+ * @brief Static information about a command from Commands.gen.
+ *
+ * @var CommandInfo::name - mnemonic in upper case.
+ * @var CommandInfo::command - command's number.
+ * @var CommandInfo::hasArg - whether the command takes an argument.
+ */
+struct CommandInfo
+{
+    const char* name;
+    Command command;
+    bool hasArg;
+};
+
+// one array for the whole program, so listing lines can be saved as indexes into it
+inline constexpr CommandInfo COMMANDS[] =
+{
+    #define DEF_COMMAND(name, num, hasArg, ...) \
+        {#name, CMD_ ## name, hasArg},
+
+    #include "Commands.gen"
+
+    #undef DEF_COMMAND
+};
+
+static constexpr size_t COMMANDS_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+/** @enum FusedArg
+ * @brief Whose argument a fused command takes.
+ *
+ * @var FusedArg::FUSED_FIRST_ARG - the first command's, the second one has no argument.
+ * @var FusedArg::FUSED_SECOND_ARG - the second command's, the first one pushes an immediate 0.
+ */
+enum FusedArg
+{
+    FUSED_FIRST_ARG,
+    FUSED_SECOND_ARG,
+};
+
+/** @struct FusedCommand
+ * @brief Command from the fused section of Commands.gen which replaces a pair of commands.
+ *
+ * @var FusedCommand::command - the fused command.
+ * @var FusedCommand::first - the first command of the pair.
+ * @var FusedCommand::second - the second one.
+ * @var FusedCommand::fusedArg - whose argument the fused command takes.
+ */
+struct FusedCommand
+{
+    Command command;
+    Command first;
+    Command second;
+    FusedArg fusedArg;
+};
+
+static constexpr FusedCommand FUSED_COMMANDS[] =
+{
+    #define DEF_COMMAND(...)
+    #define DEF_FUSED(name, num, first, second, fusedArg, ...) \
+        {CMD_ ## name, CMD_ ## first, CMD_ ## second, fusedArg},
+
+    #include "Commands.gen"
+
+    #undef DEF_FUSED
+    #undef DEF_COMMAND
+};
+
+static constexpr size_t FUSED_COMMANDS_COUNT = sizeof(FUSED_COMMANDS) / sizeof(FUSED_COMMANDS[0]);
+
+/**
+ * @brief Packs up to MAX_COMMAND_LENGTH chars of a mnemonic into an integer ignoring case.
+ *
+ * @param [in] name - the mnemonic.
+ * @param [in] length - its length.
+ *
+ * @return packed mnemonic or 0 if it is too long to be a command.
+ */
+constexpr uint32_t PackMnemonic(const char* name, size_t length)
+{
+    if (length == 0 || length > MAX_COMMAND_LENGTH)
+        return 0;
+
+    uint32_t packed = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        uint32_t c = (unsigned char)name[i];
+        if ('A' <= c && c <= 'Z')
+            c += 'a' - 'A';
+
+        packed |= c << (8 * i);
+    }
+
+    return packed;
+}
+
+static constexpr size_t MNEMONIC_TABLE_BITS = 7;
+static constexpr size_t MNEMONIC_TABLE_SIZE = 1 << MNEMONIC_TABLE_BITS;
+
+/** @struct MnemonicTable
+ * @brief Perfect hash table of packed mnemonics.
+ * Slot of a mnemonic is (packed * multiplier) >> (32 - MNEMONIC_TABLE_BITS).
+ *
+ * @var MnemonicTable::multiplier - multiplier which gives no collisions.
+ * @var MnemonicTable::mnemonics - packed mnemonic in every slot, 0 for empty ones.
+ * @var MnemonicTable::commands - index in COMMANDS for every slot.
+ */
+struct MnemonicTable
+{
+    uint32_t multiplier;
+    uint32_t mnemonics[MNEMONIC_TABLE_SIZE];
+    uint8_t  commands [MNEMONIC_TABLE_SIZE];
+};
+
+constexpr size_t _mnemonicSlot(uint32_t packed, uint32_t multiplier)
+{
+    return (packed * multiplier) >> (32 - MNEMONIC_TABLE_BITS);
+}
+
+constexpr size_t _constexprLength(const char* string)
+{
+    size_t length = 0;
+    while (string[length])
+        length++;
+    return length;
+}
+
+constexpr MnemonicTable _buildMnemonicTable()
+{
+    MnemonicTable table = {};
+
+    // Knuth's multiplicative constant, stepped by 2 to stay odd
+    for (uint32_t multiplier = 0x9E3779B1; ; multiplier += 2)
+    {
+        table = {};
+        table.multiplier = multiplier;
+
+        bool collision = false;
+        for (size_t i = 0; i < COMMANDS_COUNT && !collision; i++)
+        {
+            uint32_t packed = PackMnemonic(COMMANDS[i].name, _constexprLength(COMMANDS[i].name));
+            size_t   slot   = _mnemonicSlot(packed, multiplier);
+
+            if (table.mnemonics[slot])
+                collision = true;
+
+            table.mnemonics[slot] = packed;
+            table.commands [slot] = (uint8_t)i;
+        }
+
+        if (!collision)
+            return table;
+    }
+}
+
+static constexpr MnemonicTable MNEMONIC_TABLE = _buildMnemonicTable();
+
+/**
+ * @brief Finds a command by its mnemonic ignoring case with a single probe.
+ *
+ * @param [in] name - the mnemonic, doesn't have to be null terminated.
+ * @param [in] length - its length.
+ *
+ * @return info about the command or NULL if there is no such command.
+ */
+inline const CommandInfo* FindCommand(const char* name, size_t length)
+{
+    uint32_t packed = PackMnemonic(name, length);
+    size_t   slot   = _mnemonicSlot(packed, MNEMONIC_TABLE.multiplier);
+
+    if (packed == 0 || MNEMONIC_TABLE.mnemonics[slot] != packed)
+        return NULL;
+
+    return &COMMANDS[MNEMONIC_TABLE.commands[slot]];
+}
+
+/**
+ * @brief Finds a command by its number.
+ *
+ * @param [in] command - the number.
+ *
+ * @return info about the command or NULL if there is no such command.
+ */
+inline const CommandInfo* FindCommandByNumber(uint8_t command)
+{
+    for (size_t i = 0; i < COMMANDS_COUNT; i++)
+        if (COMMANDS[i].command == command)
+            return &COMMANDS[i];
+
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,89 @@
+//! @file
+
+#ifndef COMPILE_STATS_HPP
+#define COMPILE_STATS_HPP
+
+#include "Utils.hpp"
+
+/** @enum CompilePhase
+ * @brief Parts of @see Compile which are timed.
+ *
+ * @var CompilePhase::PHASE_READ - mapping or reading the source and splitting it into lines.
+ * @var CompilePhase::PHASE_ASSEMBLE - encoding commands, merging jobs and reading the cache.
+ * @var CompilePhase::PHASE_OPTIMIZE - @see OptimizeCode.
+ * @var CompilePhase::PHASE_RESOLVE - patching label references.
+ * @var CompilePhase::PHASE_LISTING - formatting and writing the listing.
+ * @var CompilePhase::PHASE_WRITE - writing the byte code, object or executable.
+ */
+enum CompilePhase
+{
+    PHASE_READ,
+    PHASE_ASSEMBLE,
+    PHASE_OPTIMIZE,
+    PHASE_RESOLVE,
+    PHASE_LISTING,
+    PHASE_WRITE,
+    PHASES_COUNT,
+};
+
+static const char* const COMPILE_PHASE_NAMES[PHASES_COUNT] =
+{
+    "read", "assemble", "optimize", "resolve", "listing", "write",
+};
+
+/** @struct CompileStats
+ * @brief What a compilation did and how long it took, times are in seconds of the monotonic clock.
+ *
+ * @var CompileStats::phaseTimes - time of every phase.
+ * @var CompileStats::totalTime - time of the whole compilation.
+ * @var CompileStats::lines - lines of the source.
+ * @var CompileStats::instructions - commands assembled, commands of cached blocks are not.
+ * @var CompileStats::labels - labels in the source.
+ * @var CompileStats::labelLookups - searches in label tables.
+ * @var CompileStats::labelProbes - slots the searches looked at.
+ * @var CompileStats::bytesEmitted - size of the code.
+ * @var CompileStats::allocations - arrays grown with @see GrowArray.
+ */
+struct CompileStats
+{
+    double phaseTimes[PHASES_COUNT];
+    double totalTime;
+
+    size_t lines;
+    size_t instructions;
+    size_t labels;
+    size_t labelLookups;
+    size_t labelProbes;
+    size_t bytesEmitted;
+    size_t allocations;
+};
+
+/**
+ * @brief Starts timing a phase.
+ *
+ * @param [in] stats - statistics, NULL if they are not collected.
+ *
+ * @return the time to pass to @see CompileStatsStop, 0 if stats is NULL so the clock isn't read.
+ */
+double CompileStatsStart(const CompileStats* stats);
+
+/**
+ * @brief Adds the time since @see CompileStatsStart to a phase.
+ *
+ * @param [in, out] stats - statistics, NULL if they are not collected.
+ * @param [in] phase - the phase.
+ * @param [in] start - what @see CompileStatsStart returned.
+ */
+void CompileStatsStop(CompileStats* stats, CompilePhase phase, double start);
+
+/**
+ * @brief Writes statistics as a JSON object.
+ *
+ * @param [in] file - where to write.
+ * @param [in] stats - the statistics.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode WriteCompileStatsJson(FILE* file, const CompileStats* stats);
+
+#endif
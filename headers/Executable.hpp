@@ -0,0 +1,120 @@
+//! @file
+//! Executable container: a header with a table of sections, then the sections.
+//! The code section starts at a page boundary, so a mapped file gives page aligned code.
+
+#ifndef EXECUTABLE_HPP
+#define EXECUTABLE_HPP
+
+#include "Bytecode.hpp"
+#include "LabelTable.hpp"
+
+static const uint32_t EXECUTABLE_MAGIC     = 0x58454744; // "DGEX"
+static const uint32_t EXECUTABLE_VERSION   = 1;
+static const size_t   EXECUTABLE_PAGE_SIZE = 4096;
+
+/** @enum ExecutableSectionType
+ * @brief Sections of an executable in the order of the file.
+ *
+ * @var ExecutableSectionType::SECTION_CODE - the byte code.
+ * @var ExecutableSectionType::SECTION_DATA - reserved for initial contents of the RAM. The assembler writes it empty
+ *                                            and DugongSPU refuses executables where it is not.
+ * @var ExecutableSectionType::SECTION_SYMBOLS - defined labels for debuggers: position of the label
+ *                                               @see CodeUnitSize as uint64, length of the name as uint32 and the name.
+ */
+enum ExecutableSectionType
+{
+    SECTION_CODE,
+    SECTION_DATA,
+    SECTION_SYMBOLS,
+    SECTIONS_COUNT,
+};
+
+/** @struct ExecutableSection
+ * @brief Entry of the table of sections.
+ *
+ * @var ExecutableSection::offset - where the section starts in the file.
+ * @var ExecutableSection::size - size of the section.
+ * @var ExecutableSection::checksum - @see CalculateHash64 of the section.
+ */
+struct ExecutableSection
+{
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;
+};
+
+/** @struct ExecutableHeader
+ * @brief Start of an executable.
+ *
+ * @var ExecutableHeader::magic - EXECUTABLE_MAGIC.
+ * @var ExecutableHeader::version - EXECUTABLE_VERSION, the version of this layout.
+ * @var ExecutableHeader::commandSetVersion - COMMAND_SET_VERSION the code was assembled for.
+ * @var ExecutableHeader::format - @see CodeFormat of the code.
+ * @var ExecutableHeader::entryPoint - position of the first command to run.
+ * @var ExecutableHeader::sections - table of sections.
+ * @var ExecutableHeader::checksum - @see CalculateHash64 of the header before this field.
+ */
+struct ExecutableHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t commandSetVersion;
+    uint32_t format;
+    uint64_t entryPoint;
+    ExecutableSection sections[SECTIONS_COUNT];
+    uint64_t checksum;
+};
+
+/** @struct Executable
+ * @brief Executable checked by @see ReadExecutable, sections are views into its data.
+ *
+ * @var Executable::format - how the code is written.
+ * @var Executable::entryPoint - position of the first command to run.
+ * @var Executable::sections - start of every section.
+ * @var Executable::sizes - size of every section.
+ */
+struct Executable
+{
+    CodeFormat format;
+    size_t entryPoint;
+    const byte* sections[SECTIONS_COUNT];
+    size_t sizes[SECTIONS_COUNT];
+};
+
+/**
+ * @brief Writes byte code as an executable which starts at its first command, the data section is empty.
+ *
+ * @param [in] file - where to write.
+ * @param [in] format - how the code is written.
+ * @param [in] code - the byte code.
+ * @param [in] codeSize - its size.
+ * @param [in] symbols - labels of the code, the defined ones are written to the symbol section.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode WriteExecutable(FILE* file, CodeFormat format, const byte* code, size_t codeSize, const LabelTable* symbols);
+
+/**
+ * @brief Whether data starts like an executable.
+ * The assembler never writes bare code which starts with EXECUTABLE_MAGIC, so it tells executables from it.
+ *
+ * @param [in] data - the data.
+ * @param [in] size - size of data.
+ *
+ * @return true if it does.
+ */
+bool IsExecutable(const byte* data, size_t size);
+
+/**
+ * @brief Checks an executable and finds its sections.
+ *
+ * @param [in] data - the executable, it must outlive the result.
+ * @param [in] size - size of data.
+ * @param [out] executable - the sections.
+ *
+ * @return ERROR_BAD_SIZE if the layout is broken, ERROR_BAD_HASH if a checksum doesn't match,
+ *         ERROR_BAD_VALUE if the code needs a newer command set than COMMAND_SET_VERSION.
+ */
+ErrorCode ReadExecutable(const byte* data, size_t size, Executable* executable);
+
+#endif
@@ -0,0 +1,21 @@
+//! @file
+
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include "Spu.hpp"
+
+/**
+ * @brief Translates a loaded program into x86-64 SSE2 code and runs it.
+ * Registers live in xmm registers, the data stack in an array and calls and returns are native ones
+ * bounded by the size of the SPU's call stack. Jumps by registers or RAM go through a table of commands.
+ * Stack commands, arithmetic and jumps are translated, the rest run their bodies from Commands.gen
+ * @see SpuExecuteCommand, so the results and errors are the same as @see SpuProgramRun gives.
+ *
+ * @param [in, out] program - the program.
+ *
+ * @return ErrorCode of the failed command.
+ */
+ErrorCode SpuProgramRunJit(SpuProgram* program);
+
+#endif
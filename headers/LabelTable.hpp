@@ -0,0 +1,132 @@
+//! @file
+
+#ifndef LABEL_TABLE_HPP
+#define LABEL_TABLE_HPP
+
+#include "Utils.hpp"
+#include "StringFunctions.hpp"
+
+/**
+ * @brief Returned by @see LabelTableFind if there is no such label.
+ */
+static const size_t LABEL_NOT_FOUND = (size_t)-1;
+
+/** @struct Label
+ * @brief Represents a label of the assembly code.
+ *
+ * @var Label::name - view into the source text or into the table's name blocks.
+ * @var Label::hash - hash of the name.
+ * @var Label::codePosition - where the label points to in the code.
+ * @var Label::isDefined - whether the label was met in the code or only referenced yet.
+ */
+struct Label
+{
+    String name;
+    unsigned int hash;
+    double codePosition;
+    bool isDefined;
+};
+
+struct LabelIndexResult
+{
+    size_t value;
+    ErrorCode error;
+};
+
+/** @struct NameBlock
+ * @brief Block of label names copied by a table, names never move once copied.
+ *
+ * @var NameBlock::next - previous block.
+ * @var NameBlock::used - bytes taken in this block.
+ * @var NameBlock::capacity - size of the block's data which follows the header.
+ */
+struct NameBlock
+{
+    NameBlock* next;
+    size_t used;
+    size_t capacity;
+};
+
+/** @struct LabelTable
+ * @brief Open addressing hash table of labels which grows on demand.
+ *
+ * @var LabelTable::labels - labels in the order of insertion.
+ * @var LabelTable::size - number of labels.
+ * @var LabelTable::capacity - how many labels fit without reallocation.
+ * @var LabelTable::slots - indexes of labels in labels array or LABEL_NOT_FOUND for empty slots.
+ * @var LabelTable::slotsCount - number of slots, always a power of two.
+ * @var LabelTable::nameBlocks - blocks with copied names, NULL if names are views.
+ * @var LabelTable::copyNames - whether names are copied or must outlive the table.
+ * @var LabelTable::lookups - searches by @see LabelTableInsert and @see LabelTableDefine.
+ * @var LabelTable::probes - slots the searches looked at.
+ */
+struct LabelTable
+{
+    Label* labels;
+    size_t size;
+    size_t capacity;
+
+    size_t* slots;
+    size_t slotsCount;
+
+    NameBlock* nameBlocks;
+    bool copyNames;
+
+    size_t lookups;
+    size_t probes;
+};
+
+/**
+ * @brief Allocates memory for a label table.
+ *
+ * @param [out] table - the table to init.
+ * @param [in] capacity - expected number of labels.
+ * @param [in] copyNames - copy names on insertion instead of keeping views.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode LabelTableInit(LabelTable* table, size_t capacity, bool copyNames);
+
+/**
+ * @brief Frees all table's memory.
+ *
+ * @param [in] table - the table to destroy.
+ */
+void LabelTableDestroy(LabelTable* table);
+
+/**
+ * @brief Finds a label or inserts it as not defined yet.
+ *
+ * @param [in, out] table - where to insert.
+ * @param [in] name - label's name, must outlive the table unless names are copied.
+ * @param [in] length - length of the name.
+ *
+ * @return index of the label in table->labels.
+ */
+LabelIndexResult LabelTableInsert(LabelTable* table, const char* name, size_t length);
+
+/**
+ * @brief Defines a label inserting it if needed.
+ * If the label is already defined its first code position is kept.
+ *
+ * @param [in, out] table - where to insert.
+ * @param [in] name - label's name, must outlive the table unless names are copied.
+ * @param [in] length - length of the name.
+ * @param [in] codePosition - where the label points to.
+ *
+ * @return index of the label in table->labels.
+ */
+LabelIndexResult LabelTableDefine(LabelTable* table, const char* name, size_t length, double codePosition);
+
+/**
+ * @brief Finds a label in the table.
+ *
+ * @param [in] table - where to find.
+ * @param [in] name - label's name.
+ * @param [in] length - length of the name.
+ *
+ * @return index of the label in table->labels or LABEL_NOT_FOUND.
+ */
+size_t LabelTableFind(const LabelTable* table, const char* name, size_t length);
+
+#endif
@@ -0,0 +1,83 @@
+//! @file
+
+#ifndef LEXER_HPP
+#define LEXER_HPP
+
+#include "Utils.hpp"
+#include "StringFunctions.hpp"
+#include "Bytecode.hpp"
+
+/** @enum LexemeType
+ * @brief Kinds of lexemes of a command line.
+ *
+ * @var LexemeType::LEXEME_END - the line is over.
+ * @var LexemeType::LEXEME_MNEMONIC - the first word of a line.
+ * @var LexemeType::LEXEME_REGISTER - rax, rbx and so on.
+ * @var LexemeType::LEXEME_NUMBER - a word which is a whole floating point number.
+ * @var LexemeType::LEXEME_LABEL - any other word.
+ * @var LexemeType::LEXEME_OPEN_BRACKET - '['.
+ * @var LexemeType::LEXEME_CLOSE_BRACKET - ']'.
+ * @var LexemeType::LEXEME_PLUS - '+'.
+ */
+enum LexemeType
+{
+    LEXEME_END,
+    LEXEME_MNEMONIC,
+    LEXEME_REGISTER,
+    LEXEME_NUMBER,
+    LEXEME_LABEL,
+    LEXEME_OPEN_BRACKET,
+    LEXEME_CLOSE_BRACKET,
+    LEXEME_PLUS,
+};
+
+/** @struct Lexeme
+ * @brief A piece of a line, the text is a view of the source.
+ *
+ * @var Lexeme::type - what it is.
+ * @var Lexeme::text - where it is in the line.
+ * @var Lexeme::number - value of a number.
+ * @var Lexeme::regNum - number of a register, rax is 1.
+ */
+struct Lexeme
+{
+    LexemeType type;
+    String     text;
+    double     number;
+    byte       regNum;
+};
+
+/** @struct Lexer
+ * @brief Splits a line into lexemes without copying or changing it.
+ * Words are separated by spaces, brackets and pluses.
+ *
+ * @var Lexer::position - where the next lexeme starts.
+ * @var Lexer::end - end of the line.
+ * @var Lexer::isLineStart - whether the next word is the mnemonic.
+ */
+struct Lexer
+{
+    const char* position;
+    const char* end;
+    bool        isLineStart;
+};
+
+/**
+ * @brief Starts splitting a line.
+ *
+ * @param [in] line - the line, it doesn't have to be null terminated.
+ *
+ * @return the lexer.
+ */
+Lexer CreateLexer(const String* line);
+
+/**
+ * @brief Takes the next lexeme of the line.
+ *
+ * @param [in, out] lexer - the lexer.
+ *
+ * @return the lexeme, LEXEME_END after the last one.
+ */
+Lexeme LexerNext(Lexer* lexer);
+
+#endif
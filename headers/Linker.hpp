@@ -0,0 +1,24 @@
+//! @file
+
+#ifndef LINKER_HPP
+#define LINKER_HPP
+
+#include "Utils.hpp"
+
+/**
+ * @brief Links relocatable objects into byte code.
+ * Modules are placed one after another in the given order, their symbols are resolved by name
+ * and relocations are patched with the positions of the symbols.
+ *
+ * @param [in] objectFilePaths - the objects @see WriteObjectFile.
+ * @param [in] objectsCount - number of objects.
+ * @param [in] byteCodeFilePath - where to write the byte code.
+ * @param [in] container - write an executable @see WriteExecutable with the symbols instead of bare byte code.
+ * @param [in] diagnostics - where undefined and duplicate symbols are reported, NULL for stdout.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode Link(const char* const* objectFilePaths, size_t objectsCount, const char* byteCodeFilePath,
+               bool container, FILE* diagnostics);
+
+#endif
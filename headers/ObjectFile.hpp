@@ -0,0 +1,66 @@
+//! @file
+
+#ifndef OBJECT_FILE_HPP
+#define OBJECT_FILE_HPP
+
+#include "AssemblerState.hpp"
+#include "OutputBuffer.hpp"
+
+/**
+ * @brief Size of a serialized block.
+ * A block is a part of the source assembled with deferred labels: its code starts at 0,
+ * every label reference is a fixup and lines are counted from the block's first line.
+ *
+ * @param [in] block - the block.
+ *
+ * @return size in bytes.
+ */
+size_t AssembledBlockSize(const AssemblerState* block);
+
+/**
+ * @brief Serializes a block: code, labels with their names, fixups and listing lines.
+ *
+ * @param [in, out] output - where to write.
+ * @param [in] block - the block.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode WriteAssembledBlock(OutputBuffer* output, const AssemblerState* block);
+
+/**
+ * @brief Reads a serialized block.
+ * Label names are views into the data, so it must outlive the block.
+ *
+ * @param [in] data - the serialized block.
+ * @param [in] size - size of data.
+ * @param [out] block - zeroed state to read into, format and writeListing must be set.
+ *
+ * @return ERROR_BAD_SIZE if the data is broken.
+ */
+ErrorCode ReadAssembledBlock(const byte* data, size_t size, AssemblerState* block);
+
+/**
+ * @brief Writes a relocatable object: a header and the module as a block without listing lines.
+ * Defined labels of the module are its exported symbols, undefined ones are imported
+ * and fixups are relocations of label immediates.
+ *
+ * @param [in] file - where to write.
+ * @param [in] module - the module assembled with deferred labels.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode WriteObjectFile(FILE* file, const AssemblerState* module);
+
+/**
+ * @brief Reads a relocatable object @see WriteObjectFile.
+ * Label names are views into the file's data, so it must outlive the module.
+ *
+ * @param [in] objectFilePath - the object.
+ * @param [out] module - zeroed state to read into, its format is taken from the object.
+ * @param [out] data - the file's data which must be freed.
+ *
+ * @return ERROR_BAD_FILE if the file can't be read, ERROR_BAD_SIZE if it is not an object or is broken.
+ */
+ErrorCode ReadObjectFile(const char* objectFilePath, AssemblerState* module, byte** data);
+
+#endif
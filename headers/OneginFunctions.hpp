@@ -11,20 +11,51 @@
 */
 static const char* const IGNORED_SYMBOLS = " ,.;:'\"-!?`~()[]{}";
 
+/**
+ * @brief Symbols which positions are recorded in @see TokenMarks while splitting a text.
+*/
+static const char COMMENT_SYMBOL = ';';
+static const char LABEL_SYMBOL   = ':';
+
+/** @struct TokenMarks
+ * @brief Positions of special symbols in a token found while splitting.
+ * 
+ * @var TokenMarks::comment - offset of the first COMMENT_SYMBOL or token's length if there is none.
+ * @var TokenMarks::label - offset of the first LABEL_SYMBOL before the comment or token's length if there is none.
+*/
+struct TokenMarks
+{
+    size_t comment;
+    size_t label;
+};
+
+/** @enum TextStorage
+ * @brief Who owns rawText of a @see Text.
+ * 
+ * @var TextStorage::TEXT_HEAP - rawText is a terminated heap copy of a file.
+ * @var TextStorage::TEXT_MAPPED - rawText is a read only file mapping.
+ * @var TextStorage::TEXT_BORROWED - rawText belongs to the caller.
+*/
+enum TextStorage {TEXT_HEAP, TEXT_MAPPED, TEXT_BORROWED};
+
 /** @struct Text
  * @brief Text struct which contains text itself and tokens of the text.
  * 
  * @var Text::rawText - text.
  * @var Text::tokens - const pointers to tokens in rawText.
+ * @var Text::marks - marks of every token, NULL after tokens are sorted.
  * @var Text::size - number of bytes in text.
  * @var Text::numberOfTokens - the length of tokens.
+ * @var Text::storage - who owns rawText.
 */
 struct Text
 {
     const char* rawText;
     const String* tokens;
+    const TokenMarks* marks;
     size_t size;
     size_t numberOfTokens;
+    TextStorage storage;
 };
 
 /**
@@ -36,6 +67,28 @@ struct Text
 */
 Text CreateText(const char* path, char terminator);
 
+/**
+ * @brief Creates a Text member which maps the file into memory instead of reading it.
+ * rawText is read only and is not terminated, use tokens' lengths and size.
+ * 
+ * @param [in] path - the path to a file.
+ * @param [in] terminator - what tokens are separated with.
+ * 
+ * @return Text, its rawText is NULL if the file can't be mapped.
+*/
+Text CreateTextMapped(const char* path, char terminator);
+
+/**
+ * @brief Creates a Text member over a buffer which stays owned by the caller.
+ * 
+ * @param [in] buffer - the text, doesn't have to be terminated.
+ * @param [in] size - its size.
+ * @param [in] terminator - what tokens are separated with.
+ * 
+ * @return Text.
+*/
+Text CreateTextFromBuffer(const char* buffer, size_t size, char terminator);
+
 /**
  * @brief Frees all text's memory.
  * 
@@ -0,0 +1,29 @@
+//! @file
+
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include "AssemblerState.hpp"
+
+/**
+ * @brief Peephole pass over assembled code.
+ * Folds pushes of constants followed by arithmetic, removes push/pop pairs of the same operand,
+ * threads jumps to jumps and turns "call f / ret" into "jmp f".
+ * Then splits the code into basic blocks at labels, jumps, calls, returns and halts, drops blocks which can't be
+ * reached and places every block which ends with a jmp right before its target, so the jmp can be removed.
+ * "je a / jmp b / a:" becomes "jne b / a:". The code is re-encoded in the new order and labels, fixups,
+ * listing lines and the IR are moved to the new positions.
+ * If asked, pairs of commands which nothing jumps between are replaced with fused commands from Commands.gen.
+ *
+ * The code is left as it is if jump targets can't be known: jumps by registers, RAM or numbers,
+ * labels used as data or labels which are not at the start of a command.
+ *
+ * @param [in, out] state - code assembled with deferred labels and the IR, not resolved yet.
+ * @param [in] isObject - whether the code is an object, other modules may jump to any of its labels.
+ * @param [in] fuse - whether to emit fused commands.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode OptimizeCode(AssemblerState* state, bool isObject, bool fuse);
+
+#endif
@@ -0,0 +1,112 @@
+//! @file
+
+#ifndef OUTPUT_BUFFER_HPP
+#define OUTPUT_BUFFER_HPP
+
+#include "Utils.hpp"
+
+/** @struct OutputBuffer
+ * @brief Large user space buffer in front of a file for output which is formatted by hand.
+ *
+ * @var OutputBuffer::file - where the data goes.
+ * @var OutputBuffer::data - buffered data.
+ * @var OutputBuffer::size - how many bytes are buffered.
+ * @var OutputBuffer::capacity - size of data.
+ * @var OutputBuffer::error - first error met, the buffer ignores output after it.
+ */
+struct OutputBuffer
+{
+    FILE*  file;
+    char*  data;
+    size_t size;
+    size_t capacity;
+    ErrorCode error;
+};
+
+/**
+ * @brief Allocates a buffer.
+ *
+ * @param [out] buffer - the buffer to init.
+ * @param [in] file - where to write.
+ * @param [in] capacity - size of the buffer.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode OutputBufferInit(OutputBuffer* buffer, FILE* file, size_t capacity);
+
+/**
+ * @brief Flushes the buffer and frees its memory, the file stays open.
+ *
+ * @param [in] buffer - the buffer to destroy.
+ *
+ * @return the first error of the buffer.
+ */
+ErrorCode OutputBufferDestroy(OutputBuffer* buffer);
+
+/**
+ * @brief Writes buffered data to the file.
+ *
+ * @param [in, out] buffer - the buffer.
+ *
+ * @return the first error of the buffer.
+ */
+ErrorCode OutputBufferFlush(OutputBuffer* buffer);
+
+/**
+ * @brief Makes room for size bytes.
+ * Write to the returned pointer and pass the end to @see OutputBufferCommit.
+ *
+ * @param [in, out] buffer - the buffer.
+ * @param [in] size - how many bytes will be written at most.
+ *
+ * @return where to write or NULL on error.
+ */
+char* OutputBufferReserve(OutputBuffer* buffer, size_t size);
+
+/**
+ * @brief Takes the bytes written after @see OutputBufferReserve.
+ *
+ * @param [in, out] buffer - the buffer.
+ * @param [in] end - end of the written bytes.
+ */
+void OutputBufferCommit(OutputBuffer* buffer, const char* end);
+
+/**
+ * @brief Writes bytes.
+ */
+void OutputBufferWrite(OutputBuffer* buffer, const char* data, size_t size);
+
+/**
+ * @brief Writes formatted output with vsnprintf, for places which are not hot.
+ */
+void OutputBufferPrintf(OutputBuffer* buffer, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Formats a number in upper case hex padded with zeros.
+ *
+ * @param [out] where - where to write.
+ * @param [in] value - the number.
+ * @param [in] digits - how many digits to write.
+ *
+ * @return end of the written chars.
+ */
+char* FormatHex(char* where, uint64_t value, size_t digits);
+
+/**
+ * @brief Formats a number in decimal.
+ *
+ * @param [out] where - where to write, at least 20 chars.
+ * @param [in] value - the number.
+ *
+ * @return end of the written chars.
+ */
+char* FormatDecimal(char* where, uint64_t value);
+
+/**
+ * @brief Fills with spaces.
+ *
+ * @return end of the written chars.
+ */
+char* FormatSpaces(char* where, size_t count);
+
+#endif
@@ -0,0 +1,152 @@
+//! @file
+
+#ifndef SPU_HPP
+#define SPU_HPP
+
+#include "Bytecode.hpp"
+
+static const size_t SPU_STACK_CAPACITY = 1 << 16;
+static const size_t SPU_RAM_SIZE       = 4096;
+static const size_t SPU_DRAW_WIDTH     = 64;
+
+static const uint32_t SPU_NO_RECORD = UINT32_MAX;
+
+/** @struct SpuRecord
+ * @brief Pre-decoded command, records lie in an array, so the next command is the next record.
+ *
+ * @var SpuRecord::handler - where the executor's code for the command is, set when the program is run.
+ * @var SpuRecord::immed - the immediate.
+ * @var SpuRecord::nextIp - position of the next command.
+ * @var SpuRecord::command - command's number.
+ * @var SpuRecord::argType - @see ArgType bits.
+ * @var SpuRecord::regNum - the register.
+ */
+struct alignas(32) SpuRecord
+{
+    const void* handler;
+    double      immed;
+    uint64_t    nextIp;
+    byte        command;
+    byte        argType;
+    byte        regNum;
+};
+
+/** @struct SpuStack
+ * @brief Stack of doubles with its top kept out of the array.
+ * Element i lies in data[i + 1], data[0] takes the top of an empty stack, so pushes and pops don't branch on it.
+ *
+ * @var SpuStack::data - elements under the top.
+ * @var SpuStack::size - number of elements with the top.
+ * @var SpuStack::capacity - how many elements fit.
+ * @var SpuStack::top - the top element.
+ */
+struct SpuStack
+{
+    double* data;
+    size_t  size;
+    size_t  capacity;
+    double  top;
+};
+
+/** @struct Spu
+ * @brief State which bodies of Commands.gen work with.
+ *
+ * @var Spu::stack - data stack.
+ * @var Spu::callStack - return positions of calls.
+ * @var Spu::ip - position of the next command in the byte code.
+ * @var Spu::regs - registers, @see Registers.
+ * @var Spu::ram - memory.
+ */
+struct Spu
+{
+    SpuStack* stack;
+    SpuStack* callStack;
+    uint64_t  ip;
+    double    regs[regNum + 1];
+    double*   ram;
+};
+
+struct StackElementResult
+{
+    double value;
+    ErrorCode error;
+};
+
+/** @struct ArgResult
+ * @brief Where a command's argument is, a register, a RAM cell or a temporary with the sum.
+ */
+struct ArgResult
+{
+    double* value;
+    ErrorCode error;
+};
+
+/** @struct SpuProgram
+ * @brief Byte code decoded for @see SpuProgramRun.
+ *
+ * @var SpuProgram::records - commands and one more past them which ends the program.
+ * @var SpuProgram::recordsCount - number of commands.
+ * @var SpuProgram::recordOf - record of every position in the byte code, SPU_NO_RECORD inside commands.
+ * @var SpuProgram::codeSize - size of the byte code in units of positions, @see CodeUnitSize.
+ * @var SpuProgram::entryRecord - record of the first command to run.
+ */
+struct SpuProgram
+{
+    SpuRecord* records;
+    size_t     recordsCount;
+    uint32_t*  recordOf;
+    size_t     codeSize;
+    size_t     entryRecord;
+};
+
+/**
+ * @brief Decodes byte code into records and checks that every command and argument is valid.
+ *
+ * @param [out] program - the program.
+ * @param [in] code - the byte code.
+ * @param [in] codeSize - its size.
+ * @param [in] format - how the code is written.
+ *
+ * @return ErrorCode.
+ */
+ErrorCode SpuProgramLoad(SpuProgram* program, const byte* code, size_t codeSize, CodeFormat format);
+
+/**
+ * @brief Makes a program start at another command than its first one.
+ *
+ * @param [in, out] program - the program.
+ * @param [in] entryPoint - position of the command.
+ *
+ * @return ERROR_INDEX_OUT_OF_BOUNDS if no command starts there.
+ */
+ErrorCode SpuProgramSetEntry(SpuProgram* program, size_t entryPoint);
+
+/**
+ * @brief Runs a program from its entry until hlt or its end.
+ * Commands are executed by bodies from Commands.gen, every body jumps straight to the next one's.
+ *
+ * @param [in, out] program - the program.
+ *
+ * @return ErrorCode of the failed command.
+ */
+ErrorCode SpuProgramRun(SpuProgram* program);
+
+/**
+ * @brief Executes a single command with its body from Commands.gen, for executors which handle
+ * only some commands themselves.
+ *
+ * @param [in, out] spu - the state, ip is set to the next command before the body is executed.
+ * @param [in] record - the command.
+ *
+ * @return ErrorCode of the command.
+ */
+ErrorCode SpuExecuteCommand(Spu* spu, SpuRecord* record);
+
+/**
+ * @brief Frees a program.
+ *
+ * @param [in, out] program - the program.
+ */
+void SpuProgramDestroy(SpuProgram* program);
+
+#endif
@@ -0,0 +1,109 @@
+//! @file
+
+#ifndef SPU_COMMANDS_HPP
+#define SPU_COMMANDS_HPP
+
+#include "Spu.hpp"
+
+/**
+ * @brief Pushes a value to a stack, for bodies of Commands.gen.
+ *
+ * @param [in, out] stack - the stack.
+ * @param [in] value - the value.
+ *
+ * @return ERROR_INDEX_OUT_OF_BOUNDS if the stack is full.
+ */
+static inline ErrorCode Push(SpuStack* stack, double value)
+{
+    if (stack->size == stack->capacity)
+        return ERROR_INDEX_OUT_OF_BOUNDS;
+
+    stack->data[stack->size++] = stack->top;
+    stack->top = value;
+
+    return EVERYTHING_FINE;
+}
+
+/**
+ * @brief Pops a value from a stack, for bodies of Commands.gen.
+ *
+ * @param [in, out] stack - the stack.
+ *
+ * @return the value, ERROR_INDEX_OUT_OF_BOUNDS if the stack is empty.
+ */
+static inline StackElementResult Pop(SpuStack* stack)
+{
+    if (stack->size == 0)
+        return {0, ERROR_INDEX_OUT_OF_BOUNDS};
+
+    double value = stack->top;
+    stack->top = stack->data[--stack->size];
+
+    return {value, EVERYTHING_FINE};
+}
+
+/**
+ * @brief Moves ip to a jump target which commands compute, for bodies of Commands.gen.
+ *
+ * @param [in, out] spu - the state.
+ * @param [in] target - the target, it is truncated.
+ *
+ * @return ERROR_INDEX_OUT_OF_BOUNDS if the target is not a position, executors check that a command starts there.
+ */
+static inline ErrorCode Jump(Spu* spu, double target)
+{
+    // (double)UINT64_MAX is 2^64, and NaN fails both comparisons
+    if (!(0 <= target && target < (double)UINT64_MAX))
+        return ERROR_INDEX_OUT_OF_BOUNDS;
+
+    spu->ip = (uint64_t)target;
+
+    return EVERYTHING_FINE;
+}
+
+/**
+ * @brief Finds a RAM cell by an address which commands compute.
+ *
+ * @param [in] ram - memory.
+ * @param [in] address - the address, it is truncated.
+ *
+ * @return the cell, ERROR_INDEX_OUT_OF_BOUNDS if there is no such cell.
+ */
+static inline ArgResult GetRamCell(double* ram, double address)
+{
+    if (!(0 <= address && address < (double)SPU_RAM_SIZE))
+        return {NULL, ERROR_INDEX_OUT_OF_BOUNDS};
+
+    return {&ram[(size_t)address], EVERYTHING_FINE};
+}
+
+static ErrorCode _drawMemory(const double* ram);
+
+/**
+ * @brief Prints the RAM as SPU_DRAW_WIDTH columns of '#' for non-zero cells and '.' for zero ones.
+ *
+ * @param [in] spu - the state.
+ *
+ * @return ErrorCode.
+ */
+static inline ErrorCode _drawRam(const Spu* spu)
+{
+    return _drawMemory(spu->ram);
+}
+
+static ErrorCode _drawMemory(const double* ram)
+{
+    for (size_t row = 0; row < SPU_RAM_SIZE / SPU_DRAW_WIDTH; row++)
+    {
+        char line[SPU_DRAW_WIDTH + 1] = {};
+
+        for (size_t column = 0; column < SPU_DRAW_WIDTH; column++)
+            line[column] = IsEqual(ram[row * SPU_DRAW_WIDTH + column], 0) ? '.' : '#';
+
+        puts(line);
+    }
+
+    return EVERYTHING_FINE;
+}
+
+#endif
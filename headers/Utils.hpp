@@ -49,6 +49,12 @@ static const char* ERROR_CODE_NAMES[] =
 
 static const size_t SIZET_POISON = (size_t)-1;
 
+/**
+ * @brief Format of the escape sequence which sets console color, takes a @see Color as int.
+ * Messages are printed with the colors in a single call, so lines of different threads don't mix.
+ */
+#define CONSOLE_COLOR_FORMAT "\033[0;%dm"
+
 #define RETURN_ERROR(error)                                                                                                 \
 do                                                                                                                          \
 {                                                                                                                           \
@@ -76,9 +82,8 @@ do
 #define MyAssertHard(statement, error, ...)                                                                                 \
 if (!(statement))                                                                                                           \
 do {                                                                                                                        \
-    SetConsoleColor(stderr, COLOR_RED);                                                                                     \
-    fprintf(stderr, "%s in %s in %s in line: %d\n", ERROR_CODE_NAMES[error], __FILE__, __PRETTY_FUNCTION__, __LINE__);      \
-    SetConsoleColor(stderr, COLOR_WHITE);                                                                                   \
+    fprintf(stderr, CONSOLE_COLOR_FORMAT "%s in %s in %s in line: %d\n" CONSOLE_COLOR_FORMAT, (int)COLOR_RED,             \
+            ERROR_CODE_NAMES[error], __FILE__, __PRETTY_FUNCTION__, __LINE__, (int)COLOR_WHITE);                            \
     __VA_ARGS__;                                                                                                            \
     exit(error);                                                                                                            \
 } while(0)
@@ -104,9 +109,8 @@ do {
 #define MyAssertSoft(statement, error, ...)                                                                                 \
 if (!(statement))                                                                                                           \
 do {                                                                                                                        \
-    SetConsoleColor(stderr, COLOR_RED);                                                                                     \
-    fprintf(stderr, "%s in %s in %s in line: %d\n", ERROR_CODE_NAMES[error], __FILE__, __PRETTY_FUNCTION__, __LINE__);      \
-    SetConsoleColor(stderr, COLOR_WHITE);                                                                                   \
+    fprintf(stderr, CONSOLE_COLOR_FORMAT "%s in %s in %s in line: %d\n" CONSOLE_COLOR_FORMAT, (int)COLOR_RED,             \
+            ERROR_CODE_NAMES[error], __FILE__, __PRETTY_FUNCTION__, __LINE__, (int)COLOR_WHITE);                            \
     __VA_ARGS__;                                                                                                            \
     return error;                                                                                                           \
 } while(0)
@@ -126,9 +130,8 @@ do {
 #define MyAssertSoftResult(statement, value, error, ...)                                                                    \
 if (!(statement))                                                                                                           \
 do {                                                                                                                        \
-    SetConsoleColor(stderr, COLOR_RED);                                                                                     \
-    fprintf(stderr, "%s in %s in %s in line: %d\n", ERROR_CODE_NAMES[error], __FILE__, __PRETTY_FUNCTION__, __LINE__);      \
-    SetConsoleColor(stderr, COLOR_WHITE);                                                                                   \
+    fprintf(stderr, CONSOLE_COLOR_FORMAT "%s in %s in %s in line: %d\n" CONSOLE_COLOR_FORMAT, (int)COLOR_RED,             \
+            ERROR_CODE_NAMES[error], __FILE__, __PRETTY_FUNCTION__, __LINE__, (int)COLOR_WHITE);                            \
     __VA_ARGS__;                                                                                                            \
     return {value, error};                                                                                                  \
 } while(0)
@@ -147,6 +150,11 @@ struct SourceCodePosition
     const char* name;
 };
 
+/**
+ * @brief Doubles closer than this are equal for @see IsEqual.
+ */
+extern const double ABSOLUTE_TOLERANCE;
+
 /**
  * @brief Tells if 2 doubles are equal.
  *
@@ -201,4 +209,15 @@ size_t GetFileSize(const char* path);
 
 unsigned int CalculateHash(const void *key, size_t len, unsigned int seed);
 
+/**
+ * @brief 64 bit MurmurHash64A for keys which must practically never collide, like cached contents.
+ *
+ * @param [in] key - what to hash.
+ * @param [in] len - its size.
+ * @param [in] seed - the seed.
+ *
+ * @return hash.
+ */
+uint64_t CalculateHash64(const void *key, size_t len, uint64_t seed);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,124 @@
+// translated by DugongSPU --aot
+#include "AotRuntime.hpp"
+
+static ErrorCode _run(double* stackData, double* ram, const void** returnStack)
+{
+    // the state is local, so the compiler may keep it in registers
+    SpuStack  stack        = {stackData, 0, SPU_STACK_CAPACITY, 0};
+    SpuStack  callStack    = {};
+    Spu       state        = {&stack, &callStack, 0, {}, ram};
+    Spu*      spu          = &state;
+    size_t    returnsCount = 0;
+    ArgResult argResult    = {};
+    double    argTemp      = 0;
+
+P0: // PUSH
+    argTemp = 0x1.8p+1;
+    argResult.value = &argTemp;
+    spu->ip = 9;
+    RETURN_ERROR(AOT_PUSH(spu, argResult));
+    if (spu->ip != 9)
+        goto DISPATCH;
+
+P9: // POP
+    argResult.value = &spu->regs[3];
+    spu->ip = 11;
+    RETURN_ERROR(AOT_POP(spu, argResult));
+    if (spu->ip != 11)
+        goto DISPATCH;
+
+P11: // PUSH
+    argTemp = 0;
+    argTemp += 0x1p+1;
+    argTemp += spu->regs[3];
+    argResult.value = &argTemp;
+    spu->ip = 21;
+    RETURN_ERROR(AOT_PUSH(spu, argResult));
+    if (spu->ip != 21)
+        goto DISPATCH;
+
+P21: // OUT
+    spu->ip = 22;
+    RETURN_ERROR(AOT_OUT(spu, argResult));
+    if (spu->ip != 22)
+        goto DISPATCH;
+
+P22: // PUSH
+    argTemp = 0x1p+2;
+    argResult.value = &argTemp;
+    spu->ip = 31;
+    RETURN_ERROR(AOT_PUSH(spu, argResult));
+    if (spu->ip != 31)
+        goto DISPATCH;
+
+P31: // POP
+    argResult.value = &spu->regs[2];
+    spu->ip = 33;
+    RETURN_ERROR(AOT_POP(spu, argResult));
+    if (spu->ip != 33)
+        goto DISPATCH;
+
+P33: // PUSH
+    argTemp = 0x1.5p+5;
+    argResult.value = &argTemp;
+    spu->ip = 42;
+    RETURN_ERROR(AOT_PUSH(spu, argResult));
+    if (spu->ip != 42)
+        goto P42;
+
+P42: // POP
+    argTemp = 0;
+    argTemp += 0x1.cp+3;
+    argResult = GetRamCell(spu->ram, argTemp);
+    RETURN_ERROR(argResult.error);
+    spu->ip = 51;
+    RETURN_ERROR(AOT_POP(spu, argResult));
+    if (spu->ip != 51)
+        goto DISPATCH;
+
+P51: // PUSH
+    argTemp = 0;
+    argTemp += 0x1.4p+3;
+    argTemp += spu->regs[2];
+    argResult = GetRamCell(spu->ram, argTemp);
+    RETURN_ERROR(argResult.error);
+    spu->ip = 61;
+    RETURN_ERROR(AOT_PUSH(spu, argResult));
+    if (spu->ip != 61)
+        goto DISPATCH;
+
+P61: // OUT
+    spu->ip = 62;
+    RETURN_ERROR(AOT_OUT(spu, argResult));
+    if (spu->ip != 62)
+        goto DISPATCH;
+
+P62: // HLT
+    return EVERYTHING_FINE;
+
+P63:
+    return EVERYTHING_FINE;
+
+DISPATCH:
+    switch (spu->ip)
+    {
+        case 0: goto P0;
+        case 9: goto P9;
+        case 11: goto P11;
+        case 21: goto P21;
+        case 22: goto P22;
+        case 31: goto P31;
+        case 33: goto P33;
+        case 42: goto P42;
+        case 51: goto P51;
+        case 61: goto P61;
+        case 62: goto P62;
+        case 63: goto P63;
+        default: return ERROR_INDEX_OUT_OF_BOUNDS;
+    }
+}
+
+int main()
+{
+    return AotMain(_run);
+}
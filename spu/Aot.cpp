@@ -0,0 +1,242 @@
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "Aot.hpp"
+
+#ifndef DUGONG_ROOT
+#define DUGONG_ROOT "."
+#endif
+
+static const char AOT_COMPILER[]      = "c++";
+static const char AOT_SOURCE_SUFFIX[] = ".cpp";
+
+#define AOT_COMPILE_FORMAT "%s -O2 -std=c++17 -I'" DUGONG_ROOT "/headers' '%s' '" DUGONG_ROOT "/src/Utils.cpp' " \
+                           "-o '%s' -lm"
+
+static void _writeCommand(const SpuProgram* program, const SpuRecord* record, size_t position, FILE* file);
+
+static void _writeArg(const SpuRecord* record, FILE* file);
+
+static void _writeDouble(double value, FILE* file);
+
+static bool _hasStaticTarget(const SpuProgram* program, const SpuRecord* record);
+
+ErrorCode SpuProgramWriteAot(const SpuProgram* program, FILE* file)
+{
+    MyAssertSoft(program, ERROR_NULLPTR);
+    MyAssertSoft(program->records, ERROR_NULLPTR);
+    MyAssertSoft(file, ERROR_NULLPTR);
+
+    fprintf(file, "// translated by DugongSPU --aot\n"
+                  "#include \"AotRuntime.hpp\"\n"
+                  "\n"
+                  "static ErrorCode _run(double* stackData, double* ram, const void** returnStack)\n"
+                  "{\n"
+                  "    // the state is local, so the compiler may keep it in registers\n"
+                  "    SpuStack  stack        = {stackData, 0, SPU_STACK_CAPACITY, 0};\n"
+                  "    SpuStack  callStack    = {};\n"
+                  "    Spu       state        = {&stack, &callStack, 0, {}, ram};\n"
+                  "    Spu*      spu          = &state;\n"
+                  "    size_t    returnsCount = 0;\n"
+                  "    ArgResult argResult    = {};\n"
+                  "    double    argTemp      = 0;\n"
+                  "\n");
+
+    if (program->entryRecord != 0)
+        fprintf(file, "    goto P%" PRIu64 ";\n"
+                      "\n", program->records[program->entryRecord - 1].nextIp);
+
+    for (size_t i = 0; i < program->recordsCount; i++)
+        _writeCommand(program, &program->records[i], i == 0 ? 0 : program->records[i - 1].nextIp, file);
+
+    // running off the end stops the program like hlt
+    fprintf(file, "P%zu:\n"
+                  "    return EVERYTHING_FINE;\n"
+                  "\n"
+                  "DISPATCH:\n"
+                  "    switch (spu->ip)\n"
+                  "    {\n", program->codeSize);
+
+    for (size_t i = 0; i < program->recordsCount; i++)
+    {
+        size_t position = i == 0 ? 0 : program->records[i - 1].nextIp;
+        fprintf(file, "        case %zu: goto P%zu;\n", position, position);
+    }
+
+    fprintf(file, "        case %zu: goto P%zu;\n"
+                  "        default: return ERROR_INDEX_OUT_OF_BOUNDS;\n"
+                  "    }\n"
+                  "}\n"
+                  "\n"
+                  "int main()\n"
+                  "{\n"
+                  "    return AotMain(_run);\n"
+                  "}\n", program->codeSize, program->codeSize);
+
+    return ferror(file) ? ERROR_BAD_FILE : EVERYTHING_FINE;
+}
+
+ErrorCode SpuProgramCompileAot(const SpuProgram* program, const char* outputPath)
+{
+    MyAssertSoft(program, ERROR_NULLPTR);
+    MyAssertSoft(outputPath, ERROR_NULLPTR);
+
+    // paths are quoted for the shell
+    if (strchr(outputPath, '\''))
+        return ERROR_BAD_VALUE;
+
+    size_t pathLength = strlen(outputPath);
+    char*  sourcePath = (char*)calloc(pathLength + sizeof(AOT_SOURCE_SUFFIX), sizeof(*sourcePath));
+    MyAssertSoft(sourcePath, ERROR_NO_MEMORY);
+
+    memcpy(sourcePath, outputPath, pathLength);
+    memcpy(sourcePath + pathLength, AOT_SOURCE_SUFFIX, sizeof(AOT_SOURCE_SUFFIX));
+
+    FILE* file = fopen(sourcePath, "wb");
+    MyAssertSoft(file, ERROR_BAD_FILE, free(sourcePath));
+
+    ErrorCode error = SpuProgramWriteAot(program, file);
+
+    if (fclose(file) != 0 && !error)
+        error = ERROR_BAD_FILE;
+
+    if (!error)
+    {
+        const char* compiler = getenv("CXX");
+        if (!compiler || !*compiler)
+            compiler = AOT_COMPILER;
+
+        int   commandLength = snprintf(NULL, 0, AOT_COMPILE_FORMAT, compiler, sourcePath, outputPath);
+        char* command       = (char*)calloc((size_t)commandLength + 1, sizeof(*command));
+
+        if (!command)
+            error = ERROR_NO_MEMORY;
+        else
+        {
+            snprintf(command, (size_t)commandLength + 1, AOT_COMPILE_FORMAT, compiler, sourcePath, outputPath);
+
+            if (system(command) != 0)
+                error = ERROR_BAD_FILE;
+        }
+
+        free(command);
+    }
+
+    free(sourcePath);
+
+    return error;
+}
+
+static void _writeCommand(const SpuProgram* program, const SpuRecord* record, size_t position, FILE* file)
+{
+    // records are checked when the program is loaded, so every command is known
+    const CommandInfo* info = FindCommandByNumber(record->command);
+
+    fprintf(file, "P%zu: // %s\n", position, info->name);
+
+    switch (record->command)
+    {
+        case CMD_HLT:
+            fprintf(file, "    return EVERYTHING_FINE;\n\n");
+            return;
+        case CMD_RET:
+            fprintf(file, "    if (returnsCount == 0)\n"
+                          "        return ERROR_INDEX_OUT_OF_BOUNDS;\n"
+                          "    goto *returnStack[--returnsCount];\n\n");
+            return;
+        default:
+            break;
+    }
+
+    if (record->argType)
+        _writeArg(record, file);
+
+    // bodies which jump set ip to their argument, so immediate targets are known here
+    bool isStatic = _hasStaticTarget(program, record);
+
+    if (record->command == CMD_CALL)
+    {
+        fprintf(file, "    if (returnsCount == SPU_STACK_CAPACITY)\n"
+                      "        return ERROR_INDEX_OUT_OF_BOUNDS;\n"
+                      "    returnStack[returnsCount++] = &&P%" PRIu64 ";\n", record->nextIp);
+
+        if (isStatic)
+            fprintf(file, "    goto P%" PRIu64 ";\n\n", (uint64_t)record->immed);
+        else
+            fprintf(file, "    spu->ip = (uint64_t)*argResult.value;\n"
+                          "    goto DISPATCH;\n\n");
+        return;
+    }
+
+    fprintf(file, "    spu->ip = %" PRIu64 ";\n"
+                  "    RETURN_ERROR(AOT_%s(spu, argResult));\n"
+                  "    if (spu->ip != %" PRIu64 ")\n", record->nextIp, info->name, record->nextIp);
+
+    if (isStatic)
+        fprintf(file, "        goto P%" PRIu64 ";\n\n", (uint64_t)record->immed);
+    else
+        fprintf(file, "        goto DISPATCH;\n\n");
+}
+
+static void _writeArg(const SpuRecord* record, FILE* file)
+{
+    switch (record->argType)
+    {
+        case ImmediateNumberArg:
+            fprintf(file, "    argTemp = ");
+            _writeDouble(record->immed, file);
+            fprintf(file, ";\n"
+                          "    argResult.value = &argTemp;\n");
+            return;
+        case RegisterArg:
+            fprintf(file, "    argResult.value = &spu->regs[%u];\n", record->regNum);
+            return;
+        default:
+            break;
+    }
+
+    // summed up from 0 in the same order as the SPU does
+    fprintf(file, "    argTemp = 0;\n");
+
+    if (record->argType & ImmediateNumberArg)
+    {
+        fprintf(file, "    argTemp += ");
+        _writeDouble(record->immed, file);
+        fprintf(file, ";\n");
+    }
+
+    if (record->argType & RegisterArg)
+        fprintf(file, "    argTemp += spu->regs[%u];\n", record->regNum);
+
+    if (record->argType & RAMArg)
+        fprintf(file, "    argResult = GetRamCell(spu->ram, argTemp);\n"
+                      "    RETURN_ERROR(argResult.error);\n");
+    else
+        fprintf(file, "    argResult.value = &argTemp;\n");
+}
+
+static void _writeDouble(double value, FILE* file)
+{
+    // hexadecimal literals keep every bit, infinities and NaNs have no literals
+    if (isfinite(value))
+    {
+        fprintf(file, "%a", value);
+        return;
+    }
+
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    fprintf(file, "AotDouble(0x%016" PRIx64 ")", bits);
+}
+
+static bool _hasStaticTarget(const SpuProgram* program, const SpuRecord* record)
+{
+    if (record->argType != ImmediateNumberArg)
+        return false;
+
+    if (!(0 <= record->immed && record->immed <= (double)program->codeSize))
+        return false;
+
+    return program->recordOf[(uint64_t)record->immed] != SPU_NO_RECORD;
+}
@@ -0,0 +1,958 @@
+#include <string.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include "Jit.hpp"
+
+static const size_t MAX_NATIVE_COMMAND_SIZE = 512;
+static const size_t MAX_COMMAND_FIXUPS      = 16;
+static const size_t MAX_LOCAL_JUMPS         = 4;
+
+static const uint64_t SIGN_MASK_OFF = 0x7FFFFFFFFFFFFFFF;
+
+/** @enum X86Register
+ * @brief Numbers of general purpose registers, xmm registers are numbered the same way.
+ */
+enum X86Register
+{
+    X86_RAX, X86_RCX, X86_RDX, X86_RBX, X86_RSP, X86_RBP, X86_RSI, X86_RDI,
+    X86_R8,  X86_R9,  X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15,
+};
+
+// where the translated code keeps the state, all of them are callee-saved
+static const byte JIT_CONTEXT      = X86_RBP;
+static const byte JIT_STACK_TOP    = X86_R12;
+static const byte JIT_STACK_BOTTOM = X86_R13;
+static const byte JIT_STACK_LIMIT  = X86_R14;
+static const byte JIT_RAM          = X86_R15;
+static const byte JIT_SAVED_RSP    = X86_RBX;
+
+// SPU register i lives in xmm(JIT_FIRST_REG + i)
+static const byte JIT_FIRST_REG = 8;
+
+enum X86Prefix
+{
+    X86_NO_PREFIX = 0,
+    X86_PD        = 0x66,
+    X86_SD        = 0xF2,
+};
+
+enum X86Opcode
+{
+    X86_XOR_TO     = 0x31,
+    X86_CMP        = 0x3B,
+    X86_GROUP_IMM  = 0x81,
+    X86_GROUP_IMM8 = 0x83,
+    X86_TEST       = 0x85,
+    X86_MOV_TO     = 0x89,
+    X86_MOV        = 0x8B,
+    X86_MOV_IMM32  = 0xB8,
+    X86_RET        = 0xC3,
+    X86_CALL_REL   = 0xE8,
+    X86_JMP_REL    = 0xE9,
+    X86_GROUP_FF   = 0xFF,
+
+    X86_MOVSD      = 0x0F10,
+    X86_MOVSD_TO   = 0x0F11,
+    X86_MOVAPD     = 0x0F28,
+    X86_CVTTSD2SI  = 0x0F2C,
+    X86_UCOMISD    = 0x0F2E,
+    X86_SQRTSD     = 0x0F51,
+    X86_ANDPD      = 0x0F54,
+    X86_XORPD      = 0x0F57,
+    X86_ADDSD      = 0x0F58,
+    X86_MULSD      = 0x0F59,
+    X86_SUBSD      = 0x0F5C,
+    X86_DIVSD      = 0x0F5E,
+    X86_MOVQ_TO_X  = 0x0F6E,
+    X86_MOVQ_FROM_X= 0x0F7E,
+    X86_JCC_REL    = 0x0F80,
+};
+
+// /digit of group opcodes
+enum X86Extension
+{
+    X86_EXT_ADD  = 0,
+    X86_EXT_CALL = 2,
+    X86_EXT_AND  = 4,
+    X86_EXT_JMP  = 4,
+    X86_EXT_SUB  = 5,
+    X86_EXT_CMP  = 7,
+};
+
+enum X86Condition
+{
+    X86_BELOW       = 0x2,
+    X86_ABOVE_EQUAL = 0x3,
+    X86_EQUAL       = 0x4,
+    X86_NOT_EQUAL   = 0x5,
+    X86_BELOW_EQUAL = 0x6,
+    X86_ABOVE       = 0x7,
+};
+
+/** @enum JitStub
+ * @brief Shared pieces of code after the commands.
+ *
+ * @var JitStub::STUB_OUT_OF_BOUNDS - fails with ERROR_INDEX_OUT_OF_BOUNDS.
+ * @var JitStub::STUB_EPILOGUE - returns eax.
+ * @var JitStub::STUB_DYNAMIC_JUMP - jumps to the command at the position in rax.
+ */
+enum JitStub
+{
+    STUB_OUT_OF_BOUNDS,
+    STUB_EPILOGUE,
+    STUB_DYNAMIC_JUMP,
+    STUBS_COUNT,
+};
+
+/** @struct JitContext
+ * @brief State shared by the translated code and C, its address is in JIT_CONTEXT.
+ * The data stack is laid out like @see SpuStack with the top in the array too.
+ *
+ * @var JitContext::stackTop - where the next element goes.
+ * @var JitContext::stackBottom - stackTop of an empty stack.
+ * @var JitContext::stackLimit - stackTop of a full stack.
+ * @var JitContext::ram - memory.
+ * @var JitContext::regs - registers while C code runs.
+ * @var JitContext::ip - ip after a command run by C.
+ * @var JitContext::callsTop - rsp without calls.
+ * @var JitContext::callsLimit - rsp with the most calls the SPU allows.
+ * @var JitContext::stackData - the data stack.
+ */
+struct JitContext
+{
+    double*  stackTop;
+    double*  stackBottom;
+    double*  stackLimit;
+    double*  ram;
+    double   regs[regNum + 1];
+    uint64_t ip;
+    uint64_t callsTop;
+    uint64_t callsLimit;
+    double*  stackData;
+};
+
+typedef ErrorCode (*JitEntry)(JitContext* context);
+
+struct JitFixup
+{
+    size_t position;
+    size_t label;
+};
+
+/** @struct JitJumps
+ * @brief Forward jumps inside a command which go to the same place.
+ */
+struct JitJumps
+{
+    size_t positions[MAX_LOCAL_JUMPS];
+    size_t count;
+};
+
+/** @struct JitTarget
+ * @brief Where a jump goes, a label or a place inside the command which is not emitted yet.
+ */
+struct JitTarget
+{
+    size_t    label;
+    JitJumps* local;
+};
+
+/** @struct JitBuffer
+ * @brief Code being translated.
+ *
+ * @var JitBuffer::code - the code.
+ * @var JitBuffer::size - its size.
+ * @var JitBuffer::capacity - size of code.
+ * @var JitBuffer::fixups - rel32 of jumps to labels.
+ * @var JitBuffer::fixupsCount - their number.
+ * @var JitBuffer::fixupsCapacity - size of fixups.
+ * @var JitBuffer::labels - where commands and then stubs start.
+ * @var JitBuffer::recordsCount - number of commands with the one past them.
+ * @var JitBuffer::error - whether the code didn't fit.
+ */
+struct JitBuffer
+{
+    byte*     code;
+    size_t    size;
+    size_t    capacity;
+    JitFixup* fixups;
+    size_t    fixupsCount;
+    size_t    fixupsCapacity;
+    size_t*   labels;
+    size_t    recordsCount;
+    ErrorCode error;
+};
+
+/** @struct X86Operand
+ * @brief r/m operand, a register or [base + index * scale + disp].
+ */
+struct X86Operand
+{
+    bool    isMemory;
+    bool    hasIndex;
+    byte    reg;
+    byte    base;
+    byte    index;
+    byte    scale;
+    int32_t disp;
+};
+
+static ErrorCode _translate(JitBuffer* jit, const SpuProgram* program);
+
+static void _translateRecord(JitBuffer* jit, const SpuProgram* program, size_t index);
+
+static void _translateJump(JitBuffer* jit, const SpuProgram* program, const SpuRecord* record);
+
+static void _translateCall(JitBuffer* jit, const SpuProgram* program, const SpuRecord* record);
+
+static void _translateBranch(JitBuffer* jit, const SpuProgram* program, const SpuRecord* record, size_t index);
+
+static void _translatePop(JitBuffer* jit, const SpuRecord* record);
+
+static void _translateArithmetic(JitBuffer* jit, const SpuRecord* record, uint32_t operation);
+
+static void _translateFallback(JitBuffer* jit, const SpuRecord* record);
+
+static void _emitPrologue(JitBuffer* jit);
+
+static void _emitStubs(JitBuffer* jit, const SpuProgram* program, const uint64_t* nativeTable);
+
+static void _emitCondition(JitBuffer* jit, byte command, JitTarget taken);
+
+static void _emitIsEqual(JitBuffer* jit);
+
+static void _emitLoadArg(JitBuffer* jit, const SpuRecord* record);
+
+static void _emitArgSum(JitBuffer* jit, const SpuRecord* record);
+
+static void _emitRamIndex(JitBuffer* jit);
+
+static void _emitPush(JitBuffer* jit, byte xmm);
+
+static void _emitPop(JitBuffer* jit, byte xmm);
+
+static size_t _staticTarget(const SpuProgram* program, const SpuRecord* record, size_t recordsCount);
+
+static ErrorCode _runCommand(JitContext* context, SpuRecord* record);
+
+static void _emitJump(JitBuffer* jit, uint32_t opcode, JitTarget target);
+
+static void _patchLocalJumps(JitBuffer* jit, const JitJumps* jumps);
+
+static void _emitInstruction(JitBuffer* jit, X86Prefix prefix, bool isWide, uint32_t opcode, byte reg,
+                             X86Operand rm);
+
+static void _emitSse(JitBuffer* jit, X86Prefix prefix, uint32_t opcode, byte xmm, byte rmXmm);
+
+static void _emitMovImm64(JitBuffer* jit, byte reg, uint64_t value);
+
+static void _emitMovDouble(JitBuffer* jit, byte xmm, double value);
+
+static void _emitPushReg(JitBuffer* jit, byte reg);
+
+static void _emitPopReg(JitBuffer* jit, byte reg);
+
+static void _emitByte(JitBuffer* jit, byte value);
+
+static void _emitUint32(JitBuffer* jit, uint32_t value);
+
+static X86Operand _x86Register(byte reg);
+
+static X86Operand _x86Memory(byte base, int32_t disp);
+
+static X86Operand _x86MemoryIndex(byte base, byte index, byte scale);
+
+static JitTarget _labelTarget(size_t label);
+
+static size_t _stubLabel(const JitBuffer* jit, JitStub stub);
+
+ErrorCode SpuProgramRunJit(SpuProgram* program)
+{
+    MyAssertSoft(program, ERROR_NULLPTR);
+    MyAssertSoft(program->records, ERROR_NULLPTR);
+
+    size_t recordsCount = program->recordsCount + 1;
+
+    JitBuffer jit = {};
+    jit.recordsCount   = recordsCount;
+    jit.capacity       = (recordsCount + STUBS_COUNT + 1) * MAX_NATIVE_COMMAND_SIZE;
+    jit.fixupsCapacity = (recordsCount + STUBS_COUNT + 1) * MAX_COMMAND_FIXUPS;
+    jit.code           = (byte*)    calloc(jit.capacity,                sizeof(*jit.code));
+    jit.fixups         = (JitFixup*)calloc(jit.fixupsCapacity,          sizeof(*jit.fixups));
+    jit.labels         = (size_t*)  calloc(recordsCount + STUBS_COUNT,  sizeof(*jit.labels));
+
+    uint64_t* nativeTable = (uint64_t*)calloc(recordsCount, sizeof(*nativeTable));
+    double*   stackData   = (double*)  calloc(SPU_STACK_CAPACITY + 1, sizeof(*stackData));
+    double*   ram         = (double*)  calloc(SPU_RAM_SIZE, sizeof(*ram));
+
+    ErrorCode error = jit.code && jit.fixups && jit.labels && nativeTable && stackData && ram ?
+                      EVERYTHING_FINE : ERROR_NO_MEMORY;
+
+    if (!error)
+    {
+        _emitPrologue(&jit);
+
+        if (program->entryRecord != 0)
+            _emitJump(&jit, X86_JMP_REL, _labelTarget(program->entryRecord));
+
+        error = _translate(&jit, program);
+    }
+
+    if (!error)
+        _emitStubs(&jit, program, nativeTable);
+
+    if (!error)
+        error = jit.error;
+
+    void* mapping = MAP_FAILED;
+    if (!error)
+    {
+        mapping = mmap(NULL, jit.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+            error = ERROR_NO_MEMORY;
+    }
+
+    if (!error)
+    {
+        for (size_t i = 0; i < jit.fixupsCount; i++)
+        {
+            int32_t relative = (int32_t)((int64_t)jit.labels[jit.fixups[i].label] -
+                                         (int64_t)(jit.fixups[i].position + sizeof(relative)));
+            memcpy(jit.code + jit.fixups[i].position, &relative, sizeof(relative));
+        }
+
+        memcpy(mapping, jit.code, jit.size);
+
+        for (size_t i = 0; i < recordsCount; i++)
+            nativeTable[i] = (uintptr_t)((byte*)mapping + jit.labels[i]);
+
+        if (mprotect(mapping, jit.size, PROT_READ | PROT_EXEC) != 0)
+            error = ERROR_BAD_VALUE;
+    }
+
+    if (!error)
+    {
+        JitContext context = {};
+        context.stackData   = stackData;
+        context.stackTop    = stackData + 1;
+        context.stackBottom = stackData + 1;
+        context.stackLimit  = stackData + SPU_STACK_CAPACITY + 1;
+        context.ram         = ram;
+
+        JitEntry entry = NULL;
+        memcpy(&entry, &mapping, sizeof(entry));
+
+        error = entry(&context);
+    }
+
+    if (mapping != MAP_FAILED)
+        munmap(mapping, jit.size);
+
+    free(jit.code);
+    free(jit.fixups);
+    free(jit.labels);
+    free(nativeTable);
+    free(stackData);
+    free(ram);
+
+    return error;
+}
+
+static ErrorCode _translate(JitBuffer* jit, const SpuProgram* program)
+{
+    // the record past the commands is hlt, so running off the end stops the program
+    for (size_t i = 0; i < jit->recordsCount && !jit->error; i++)
+    {
+        jit->labels[i] = jit->size;
+
+        if (jit->fixupsCapacity - jit->fixupsCount < MAX_COMMAND_FIXUPS)
+            return ERROR_BAD_SIZE;
+
+        _translateRecord(jit, program, i);
+    }
+
+    return jit->error;
+}
+
+static void _translateRecord(JitBuffer* jit, const SpuProgram* program, size_t index)
+{
+    const SpuRecord* record = &program->records[index];
+
+    switch (record->command)
+    {
+        case CMD_PUSH:
+            _emitLoadArg(jit, record);
+            _emitPush(jit, 0);
+            break;
+        case CMD_POP:
+            _translatePop(jit, record);
+            break;
+        case CMD_JMP:
+            _translateJump(jit, program, record);
+            break;
+        case CMD_CALL:
+            _translateCall(jit, program, record);
+            break;
+        case CMD_RET:
+            _emitInstruction(jit, X86_NO_PREFIX, true, X86_CMP, X86_RSP,
+                             _x86Memory(JIT_CONTEXT, offsetof(JitContext, callsTop)));
+            _emitJump(jit, X86_JCC_REL | X86_ABOVE_EQUAL, _labelTarget(_stubLabel(jit, STUB_OUT_OF_BOUNDS)));
+            _emitByte(jit, X86_RET);
+            break;
+        case CMD_JA:
+        case CMD_JAE:
+        case CMD_JB:
+        case CMD_JBE:
+        case CMD_JE:
+        case CMD_JNE:
+        case CMD_JAZ:
+        case CMD_JNEZ:
+            _translateBranch(jit, program, record, index);
+            break;
+        case CMD_ADD:
+        case CMD_ADDP:
+            _translateArithmetic(jit, record, X86_ADDSD);
+            break;
+        case CMD_SUB:
+        case CMD_SUBP:
+            _translateArithmetic(jit, record, X86_SUBSD);
+            break;
+        case CMD_MUL:
+        case CMD_MULP:
+            _translateArithmetic(jit, record, X86_MULSD);
+            break;
+        case CMD_DIV:
+        case CMD_DIVP:
+            _translateArithmetic(jit, record, X86_DIVSD);
+            break;
+        case CMD_SQRT:
+            _emitPop(jit, 0);
+            _emitSse(jit, X86_SD, X86_SQRTSD, 0, 0);
+            _emitPush(jit, 0);
+            break;
+        case CMD_VAR:
+            break;
+        case CMD_HLT:
+            _emitInstruction(jit, X86_NO_PREFIX, false, X86_XOR_TO, X86_RAX, _x86Register(X86_RAX));
+            _emitJump(jit, X86_JMP_REL, _labelTarget(_stubLabel(jit, STUB_EPILOGUE)));
+            break;
+        default:
+            _translateFallback(jit, record);
+            break;
+    }
+}
+
+static void _translateJump(JitBuffer* jit, const SpuProgram* program, const SpuRecord* record)
+{
+    if (record->argType == ImmediateNumberArg)
+    {
+        _emitJump(jit, X86_JMP_REL, _labelTarget(_staticTarget(program, record, jit->recordsCount)));
+        return;
+    }
+
+    _emitLoadArg(jit, record);
+    _emitInstruction(jit, X86_SD, true, X86_CVTTSD2SI, X86_RAX, _x86Register(0));
+    _emitJump(jit, X86_JMP_REL, _labelTarget(_stubLabel(jit, STUB_DYNAMIC_JUMP)));
+}
+
+static void _translateCall(JitBuffer* jit, const SpuProgram* program, const SpuRecord* record)
+{
+    bool isStatic = record->argType == ImmediateNumberArg;
+
+    // the argument is found before the return position is pushed, like the SPU does
+    if (!isStatic)
+    {
+        _emitLoadArg(jit, record);
+        _emitInstruction(jit, X86_SD, true, X86_CVTTSD2SI, X86_RDX, _x86Register(0));
+    }
+
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_CMP, X86_RSP,
+                     _x86Memory(JIT_CONTEXT, offsetof(JitContext, callsLimit)));
+    _emitJump(jit, X86_JCC_REL | X86_BELOW_EQUAL, _labelTarget(_stubLabel(jit, STUB_OUT_OF_BOUNDS)));
+
+    if (isStatic)
+    {
+        size_t target = _staticTarget(program, record, jit->recordsCount);
+
+        _emitJump(jit, target == _stubLabel(jit, STUB_OUT_OF_BOUNDS) ? X86_JMP_REL : X86_CALL_REL,
+                  _labelTarget(target));
+        return;
+    }
+
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, X86_RAX, _x86Register(X86_RDX));
+    _emitJump(jit, X86_CALL_REL, _labelTarget(_stubLabel(jit, STUB_DYNAMIC_JUMP)));
+}
+
+static void _translateBranch(JitBuffer* jit, const SpuProgram* program, const SpuRecord* record, size_t index)
+{
+    bool isStatic = record->argType == ImmediateNumberArg;
+
+    if (!isStatic)
+    {
+        _emitLoadArg(jit, record);
+        _emitInstruction(jit, X86_SD, true, X86_CVTTSD2SI, X86_RDX, _x86Register(0));
+    }
+
+    // a in xmm0, b in xmm1
+    if (record->command == CMD_JAZ || record->command == CMD_JNEZ)
+    {
+        _emitPop(jit, 0);
+        _emitSse(jit, X86_PD, X86_XORPD, 1, 1);
+    }
+    else
+    {
+        _emitPop(jit, 1);
+        _emitPop(jit, 0);
+    }
+
+    if (isStatic)
+    {
+        _emitCondition(jit, record->command, _labelTarget(_staticTarget(program, record, jit->recordsCount)));
+        return;
+    }
+
+    JitJumps taken = {};
+    _emitCondition(jit, record->command, {0, &taken});
+    _emitJump(jit, X86_JMP_REL, _labelTarget(index + 1));
+
+    _patchLocalJumps(jit, &taken);
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, X86_RAX, _x86Register(X86_RDX));
+    _emitJump(jit, X86_JMP_REL, _labelTarget(_stubLabel(jit, STUB_DYNAMIC_JUMP)));
+}
+
+static void _translatePop(JitBuffer* jit, const SpuRecord* record)
+{
+    if (record->argType == RegisterArg)
+    {
+        _emitPop(jit, (byte)(JIT_FIRST_REG + record->regNum));
+        return;
+    }
+
+    // the cell is checked before the stack, like the SPU does
+    _emitArgSum(jit, record);
+    _emitRamIndex(jit);
+    _emitPop(jit, 0);
+    _emitInstruction(jit, X86_SD, false, X86_MOVSD_TO, 0, _x86MemoryIndex(JIT_RAM, X86_RAX, sizeof(double)));
+}
+
+static void _translateArithmetic(JitBuffer* jit, const SpuRecord* record, uint32_t operation)
+{
+    // fused commands take b from their argument instead of the stack
+    if (record->argType)
+    {
+        _emitLoadArg(jit, record);
+        _emitSse(jit, X86_PD, X86_MOVAPD, 1, 0);
+    }
+    else
+        _emitPop(jit, 1);
+
+    _emitPop(jit, 0);
+    _emitSse(jit, X86_SD, operation, 0, 1);
+    _emitPush(jit, 0);
+}
+
+static void _translateFallback(JitBuffer* jit, const SpuRecord* record)
+{
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV_TO, JIT_STACK_TOP,
+                     _x86Memory(JIT_CONTEXT, offsetof(JitContext, stackTop)));
+
+    for (byte reg = 0; reg <= regNum; reg++)
+        _emitInstruction(jit, X86_SD, false, X86_MOVSD_TO, (byte)(JIT_FIRST_REG + reg),
+                         _x86Memory(JIT_CONTEXT, (int32_t)(offsetof(JitContext, regs) + reg * sizeof(double))));
+
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, X86_RDI, _x86Register(JIT_CONTEXT));
+    _emitMovImm64(jit, X86_RSI, (uintptr_t)record);
+    _emitMovImm64(jit, X86_RAX, (uintptr_t)_runCommand);
+
+    // the depth of SPU calls moves rsp by 8, C wants it aligned to 16
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, JIT_SAVED_RSP, _x86Register(X86_RSP));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_GROUP_IMM8, X86_EXT_AND, _x86Register(X86_RSP));
+    _emitByte(jit, 0xF0);
+    _emitInstruction(jit, X86_NO_PREFIX, false, X86_GROUP_FF, X86_EXT_CALL, _x86Register(X86_RAX));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, X86_RSP, _x86Register(JIT_SAVED_RSP));
+
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, JIT_STACK_TOP,
+                     _x86Memory(JIT_CONTEXT, offsetof(JitContext, stackTop)));
+
+    for (byte reg = 0; reg <= regNum; reg++)
+        _emitInstruction(jit, X86_SD, false, X86_MOVSD, (byte)(JIT_FIRST_REG + reg),
+                         _x86Memory(JIT_CONTEXT, (int32_t)(offsetof(JitContext, regs) + reg * sizeof(double))));
+
+    _emitInstruction(jit, X86_NO_PREFIX, false, X86_TEST, X86_RAX, _x86Register(X86_RAX));
+    _emitJump(jit, X86_JCC_REL | X86_NOT_EQUAL, _labelTarget(_stubLabel(jit, STUB_EPILOGUE)));
+
+    // the body may have jumped
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, X86_RAX, _x86Memory(JIT_CONTEXT, offsetof(JitContext, ip)));
+    _emitMovImm64(jit, X86_RCX, record->nextIp);
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_CMP, X86_RAX, _x86Register(X86_RCX));
+    _emitJump(jit, X86_JCC_REL | X86_NOT_EQUAL, _labelTarget(_stubLabel(jit, STUB_DYNAMIC_JUMP)));
+}
+
+static void _emitPrologue(JitBuffer* jit)
+{
+    _emitPushReg(jit, X86_RBX);
+    _emitPushReg(jit, X86_RBP);
+    _emitPushReg(jit, X86_R12);
+    _emitPushReg(jit, X86_R13);
+    _emitPushReg(jit, X86_R14);
+    _emitPushReg(jit, X86_R15);
+
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, JIT_CONTEXT, _x86Register(X86_RDI));
+
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, JIT_STACK_TOP,
+                     _x86Memory(JIT_CONTEXT, offsetof(JitContext, stackTop)));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, JIT_STACK_BOTTOM,
+                     _x86Memory(JIT_CONTEXT, offsetof(JitContext, stackBottom)));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, JIT_STACK_LIMIT,
+                     _x86Memory(JIT_CONTEXT, offsetof(JitContext, stackLimit)));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, JIT_RAM,
+                     _x86Memory(JIT_CONTEXT, offsetof(JitContext, ram)));
+
+    for (byte reg = 0; reg <= regNum; reg++)
+        _emitSse(jit, X86_PD, X86_XORPD, (byte)(JIT_FIRST_REG + reg), (byte)(JIT_FIRST_REG + reg));
+
+    // SPU calls are native ones, so the call stack is the part of the machine stack below callsTop
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV_TO, X86_RSP,
+                     _x86Memory(JIT_CONTEXT, offsetof(JitContext, callsTop)));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, X86_RAX, _x86Register(X86_RSP));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_GROUP_IMM, X86_EXT_SUB, _x86Register(X86_RAX));
+    _emitUint32(jit, (uint32_t)(SPU_STACK_CAPACITY * sizeof(uint64_t)));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV_TO, X86_RAX,
+                     _x86Memory(JIT_CONTEXT, offsetof(JitContext, callsLimit)));
+}
+
+static void _emitStubs(JitBuffer* jit, const SpuProgram* program, const uint64_t* nativeTable)
+{
+    jit->labels[_stubLabel(jit, STUB_OUT_OF_BOUNDS)] = jit->size;
+    _emitByte(jit, X86_MOV_IMM32 + X86_RAX);
+    _emitUint32(jit, ERROR_INDEX_OUT_OF_BOUNDS);
+
+    // calls and data on the machine stack are dropped at once
+    jit->labels[_stubLabel(jit, STUB_EPILOGUE)] = jit->size;
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_MOV, X86_RSP, _x86Memory(JIT_CONTEXT, offsetof(JitContext, callsTop)));
+    _emitPopReg(jit, X86_R15);
+    _emitPopReg(jit, X86_R14);
+    _emitPopReg(jit, X86_R13);
+    _emitPopReg(jit, X86_R12);
+    _emitPopReg(jit, X86_RBP);
+    _emitPopReg(jit, X86_RBX);
+    _emitByte(jit, X86_RET);
+
+    JitTarget outOfBounds = _labelTarget(_stubLabel(jit, STUB_OUT_OF_BOUNDS));
+
+    jit->labels[_stubLabel(jit, STUB_DYNAMIC_JUMP)] = jit->size;
+    _emitMovImm64(jit, X86_RCX, program->codeSize);
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_CMP, X86_RAX, _x86Register(X86_RCX));
+    _emitJump(jit, X86_JCC_REL | X86_ABOVE, outOfBounds);
+
+    _emitMovImm64(jit, X86_RCX, (uintptr_t)program->recordOf);
+    _emitInstruction(jit, X86_NO_PREFIX, false, X86_MOV, X86_RAX, _x86MemoryIndex(X86_RCX, X86_RAX, sizeof(uint32_t)));
+    _emitInstruction(jit, X86_NO_PREFIX, false, X86_GROUP_IMM8, X86_EXT_CMP, _x86Register(X86_RAX));
+    _emitByte(jit, (byte)SPU_NO_RECORD);
+    _emitJump(jit, X86_JCC_REL | X86_EQUAL, outOfBounds);
+
+    _emitMovImm64(jit, X86_RCX, (uintptr_t)nativeTable);
+    _emitInstruction(jit, X86_NO_PREFIX, false, X86_GROUP_FF, X86_EXT_JMP,
+                     _x86MemoryIndex(X86_RCX, X86_RAX, sizeof(uint64_t)));
+}
+
+static void _emitCondition(JitBuffer* jit, byte command, JitTarget taken)
+{
+    // ucomisd sets CF and ZF for NaNs, so "above" is false for them like comparisons in C
+    switch (command)
+    {
+        case CMD_JA:
+        case CMD_JAE:
+        case CMD_JAZ:
+            _emitSse(jit, X86_PD, X86_UCOMISD, 0, 1);
+            _emitJump(jit, X86_JCC_REL | X86_ABOVE, taken);
+            break;
+        case CMD_JB:
+        case CMD_JBE:
+            _emitSse(jit, X86_PD, X86_UCOMISD, 1, 0);
+            _emitJump(jit, X86_JCC_REL | X86_ABOVE, taken);
+            break;
+        default:
+            break;
+    }
+
+    switch (command)
+    {
+        case CMD_JAE:
+        case CMD_JBE:
+        case CMD_JE:
+            _emitIsEqual(jit);
+            _emitJump(jit, X86_JCC_REL | X86_ABOVE, taken);
+            break;
+        case CMD_JNE:
+        case CMD_JNEZ:
+            _emitIsEqual(jit);
+            _emitJump(jit, X86_JCC_REL | X86_BELOW_EQUAL, taken);
+            break;
+        default:
+            break;
+    }
+}
+
+static void _emitIsEqual(JitBuffer* jit)
+{
+    // ABSOLUTE_TOLERANCE > fabs(a - b), "above" means equal
+    _emitSse(jit, X86_PD, X86_MOVAPD, 2, 0);
+    _emitSse(jit, X86_SD, X86_SUBSD, 2, 1);
+    _emitMovImm64(jit, X86_RAX, SIGN_MASK_OFF);
+    _emitInstruction(jit, X86_PD, true, X86_MOVQ_TO_X, 3, _x86Register(X86_RAX));
+    _emitSse(jit, X86_PD, X86_ANDPD, 2, 3);
+    _emitMovDouble(jit, 3, ABSOLUTE_TOLERANCE);
+    _emitSse(jit, X86_PD, X86_UCOMISD, 3, 2);
+}
+
+static void _emitLoadArg(JitBuffer* jit, const SpuRecord* record)
+{
+    switch (record->argType)
+    {
+        case ImmediateNumberArg:
+            _emitMovDouble(jit, 0, record->immed);
+            return;
+        case RegisterArg:
+            _emitSse(jit, X86_PD, X86_MOVAPD, 0, (byte)(JIT_FIRST_REG + record->regNum));
+            return;
+        default:
+            break;
+    }
+
+    _emitArgSum(jit, record);
+
+    if (record->argType & RAMArg)
+    {
+        _emitRamIndex(jit);
+        _emitInstruction(jit, X86_SD, false, X86_MOVSD, 0, _x86MemoryIndex(JIT_RAM, X86_RAX, sizeof(double)));
+    }
+}
+
+static void _emitArgSum(JitBuffer* jit, const SpuRecord* record)
+{
+    // summed up from 0 in the same order as the SPU does, so -0.0 turns into 0.0 the same way
+    _emitSse(jit, X86_PD, X86_XORPD, 0, 0);
+
+    if (record->argType & ImmediateNumberArg)
+    {
+        _emitMovDouble(jit, 1, record->immed);
+        _emitSse(jit, X86_SD, X86_ADDSD, 0, 1);
+    }
+
+    if (record->argType & RegisterArg)
+        _emitSse(jit, X86_SD, X86_ADDSD, 0, (byte)(JIT_FIRST_REG + record->regNum));
+}
+
+static void _emitRamIndex(JitBuffer* jit)
+{
+    JitTarget outOfBounds = _labelTarget(_stubLabel(jit, STUB_OUT_OF_BOUNDS));
+
+    // negative addresses and NaNs set CF
+    _emitSse(jit, X86_PD, X86_XORPD, 1, 1);
+    _emitSse(jit, X86_PD, X86_UCOMISD, 0, 1);
+    _emitJump(jit, X86_JCC_REL | X86_BELOW, outOfBounds);
+
+    _emitInstruction(jit, X86_SD, true, X86_CVTTSD2SI, X86_RAX, _x86Register(0));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_GROUP_IMM, X86_EXT_CMP, _x86Register(X86_RAX));
+    _emitUint32(jit, (uint32_t)SPU_RAM_SIZE);
+    _emitJump(jit, X86_JCC_REL | X86_ABOVE_EQUAL, outOfBounds);
+}
+
+static void _emitPush(JitBuffer* jit, byte xmm)
+{
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_CMP, JIT_STACK_TOP, _x86Register(JIT_STACK_LIMIT));
+    _emitJump(jit, X86_JCC_REL | X86_ABOVE_EQUAL, _labelTarget(_stubLabel(jit, STUB_OUT_OF_BOUNDS)));
+
+    _emitInstruction(jit, X86_SD, false, X86_MOVSD_TO, xmm, _x86Memory(JIT_STACK_TOP, 0));
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_GROUP_IMM8, X86_EXT_ADD, _x86Register(JIT_STACK_TOP));
+    _emitByte(jit, sizeof(double));
+}
+
+static void _emitPop(JitBuffer* jit, byte xmm)
+{
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_CMP, JIT_STACK_TOP, _x86Register(JIT_STACK_BOTTOM));
+    _emitJump(jit, X86_JCC_REL | X86_BELOW_EQUAL, _labelTarget(_stubLabel(jit, STUB_OUT_OF_BOUNDS)));
+
+    _emitInstruction(jit, X86_NO_PREFIX, true, X86_GROUP_IMM8, X86_EXT_SUB, _x86Register(JIT_STACK_TOP));
+    _emitByte(jit, sizeof(double));
+    _emitInstruction(jit, X86_SD, false, X86_MOVSD, xmm, _x86Memory(JIT_STACK_TOP, 0));
+}
+
+static size_t _staticTarget(const SpuProgram* program, const SpuRecord* record, size_t recordsCount)
+{
+    size_t outOfBounds = recordsCount + STUB_OUT_OF_BOUNDS;
+
+    if (!(0 <= record->immed && record->immed <= (double)program->codeSize))
+        return outOfBounds;
+
+    uint32_t target = program->recordOf[(uint64_t)record->immed];
+
+    return target == SPU_NO_RECORD ? outOfBounds : target;
+}
+
+static ErrorCode _runCommand(JitContext* context, SpuRecord* record)
+{
+    // the translated stack has its top in the array, SpuStack keeps it aside
+    size_t size = (size_t)(context->stackTop - context->stackData) - 1;
+
+    SpuStack stack     = {context->stackData, size, SPU_STACK_CAPACITY, context->stackData[size]};
+    SpuStack callStack = {};
+    Spu      spu       = {&stack, &callStack, 0, {}, context->ram};
+    memcpy(spu.regs, context->regs, sizeof(spu.regs));
+
+    ErrorCode error = SpuExecuteCommand(&spu, record);
+
+    context->stackData[stack.size] = stack.top;
+    context->stackTop = context->stackData + stack.size + 1;
+    context->ip       = spu.ip;
+    memcpy(context->regs, spu.regs, sizeof(spu.regs));
+
+    return error;
+}
+
+static void _emitJump(JitBuffer* jit, uint32_t opcode, JitTarget target)
+{
+    if (opcode > 0xFF)
+        _emitByte(jit, (byte)(opcode >> 8));
+    _emitByte(jit, (byte)opcode);
+
+    if (target.local)
+        target.local->positions[target.local->count++] = jit->size;
+    else if (jit->fixupsCount < jit->fixupsCapacity)
+        jit->fixups[jit->fixupsCount++] = {jit->size, target.label};
+    else
+        jit->error = ERROR_BAD_SIZE;
+
+    _emitUint32(jit, 0);
+}
+
+static void _patchLocalJumps(JitBuffer* jit, const JitJumps* jumps)
+{
+    for (size_t i = 0; i < jumps->count && !jit->error; i++)
+    {
+        int32_t relative = (int32_t)(jit->size - (jumps->positions[i] + sizeof(relative)));
+        memcpy(jit->code + jumps->positions[i], &relative, sizeof(relative));
+    }
+}
+
+static void _emitInstruction(JitBuffer* jit, X86Prefix prefix, bool isWide, uint32_t opcode, byte reg,
+                             X86Operand rm)
+{
+    if (prefix != X86_NO_PREFIX)
+        _emitByte(jit, (byte)prefix);
+
+    byte rmReg = rm.isMemory ? rm.base : rm.reg;
+    byte rex   = (byte)(0x40 | (isWide << 3) | ((reg >> 3) << 2) | ((rm.hasIndex ? rm.index >> 3 : 0) << 1) |
+                        (rmReg >> 3));
+    if (rex != 0x40)
+        _emitByte(jit, rex);
+
+    if (opcode > 0xFF)
+        _emitByte(jit, (byte)(opcode >> 8));
+    _emitByte(jit, (byte)opcode);
+
+    if (!rm.isMemory)
+    {
+        _emitByte(jit, (byte)(0xC0 | (reg & 7) << 3 | (rm.reg & 7)));
+        return;
+    }
+
+    // disp8 or disp32 always, so rbp and r13 need no special case
+    bool isShort = -128 <= rm.disp && rm.disp <= 127;
+    byte mod     = isShort ? 0x40 : 0x80;
+
+    if (rm.hasIndex || (rm.base & 7) == X86_RSP)
+    {
+        byte scaleBits = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+
+        _emitByte(jit, (byte)(mod | (reg & 7) << 3 | X86_RSP));
+        _emitByte(jit, (byte)(scaleBits << 6 | (rm.hasIndex ? rm.index & 7 : X86_RSP) << 3 | (rm.base & 7)));
+    }
+    else
+        _emitByte(jit, (byte)(mod | (reg & 7) << 3 | (rm.base & 7)));
+
+    if (isShort)
+        _emitByte(jit, (byte)rm.disp);
+    else
+        _emitUint32(jit, (uint32_t)rm.disp);
+}
+
+static void _emitSse(JitBuffer* jit, X86Prefix prefix, uint32_t opcode, byte xmm, byte rmXmm)
+{
+    _emitInstruction(jit, prefix, false, opcode, xmm, _x86Register(rmXmm));
+}
+
+static void _emitMovImm64(JitBuffer* jit, byte reg, uint64_t value)
+{
+    _emitByte(jit, (byte)(0x48 | (reg >> 3)));
+    _emitByte(jit, (byte)(X86_MOV_IMM32 + (reg & 7)));
+
+    for (size_t i = 0; i < sizeof(value); i++)
+        _emitByte(jit, (byte)(value >> (8 * i)));
+}
+
+static void _emitMovDouble(JitBuffer* jit, byte xmm, double value)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    _emitMovImm64(jit, X86_RAX, bits);
+    _emitInstruction(jit, X86_PD, true, X86_MOVQ_TO_X, xmm, _x86Register(X86_RAX));
+}
+
+static void _emitPushReg(JitBuffer* jit, byte reg)
+{
+    if (reg >> 3)
+        _emitByte(jit, 0x41);
+    _emitByte(jit, (byte)(0x50 + (reg & 7)));
+}
+
+static void _emitPopReg(JitBuffer* jit, byte reg)
+{
+    if (reg >> 3)
+        _emitByte(jit, 0x41);
+    _emitByte(jit, (byte)(0x58 + (reg & 7)));
+}
+
+static void _emitByte(JitBuffer* jit, byte value)
+{
+    if (jit->size == jit->capacity)
+    {
+        jit->error = ERROR_BAD_SIZE;
+        return;
+    }
+
+    jit->code[jit->size++] = value;
+}
+
+static void _emitUint32(JitBuffer* jit, uint32_t value)
+{
+    for (size_t i = 0; i < sizeof(value); i++)
+        _emitByte(jit, (byte)(value >> (8 * i)));
+}
+
+static X86Operand _x86Register(byte reg)
+{
+    return {false, false, reg, 0, 0, 0, 0};
+}
+
+static X86Operand _x86Memory(byte base, int32_t disp)
+{
+    return {true, false, 0, base, 0, 0, disp};
+}
+
+static X86Operand _x86MemoryIndex(byte base, byte index, byte scale)
+{
+    return {true, true, 0, base, index, scale, 0};
+}
+
+static JitTarget _labelTarget(size_t label)
+{
+    return {label, NULL};
+}
+
+static size_t _stubLabel(const JitBuffer* jit, JitStub stub)
+{
+    return jit->recordsCount + stub;
+}
@@ -0,0 +1,259 @@
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "SpuCommands.hpp"
+
+static const size_t MAX_COMMANDS = 1 << BITS_FOR_COMMAND;
+
+static ErrorCode _checkRecord(const SpuRecord* record);
+
+static ErrorCode _execute(SpuProgram* program, double* stackData, double* callStackData, double* ram);
+
+static inline ArgResult _getArg(Spu* spu, SpuRecord* record, double* temp);
+
+ErrorCode SpuProgramLoad(SpuProgram* program, const byte* code, size_t codeSize, CodeFormat format)
+{
+    MyAssertSoft(program, ERROR_NULLPTR);
+    MyAssertSoft(code || codeSize == 0, ERROR_NULLPTR);
+    MyAssertSoft(codeSize < SPU_NO_RECORD, ERROR_BAD_SIZE);
+
+    // jumps address commands of aligned code by index
+    size_t unitSize = CodeUnitSize(format);
+
+    *program = {};
+    program->codeSize = codeSize / unitSize;
+
+    // a command takes at least one byte, so there are at most codeSize of them and one more past them
+    program->records  = (SpuRecord*)aligned_alloc(alignof(SpuRecord), (codeSize + 1) * sizeof(*program->records));
+    program->recordOf = (uint32_t*) calloc(codeSize + 1, sizeof(*program->recordOf));
+    MyAssertSoft(program->records && program->recordOf, ERROR_NO_MEMORY, SpuProgramDestroy(program));
+
+    memset(program->records, 0, (codeSize + 1) * sizeof(*program->records));
+    memset(program->recordOf, 0xFF, (codeSize + 1) * sizeof(*program->recordOf));
+
+    for (size_t position = 0; position < codeSize; )
+    {
+        InstructionResult instructionRes = DecodeInstruction(code + position, codeSize - position, format);
+        if (instructionRes.error)
+        {
+            SpuProgramDestroy(program);
+            return instructionRes.error;
+        }
+
+        const Instruction* instruction = &instructionRes.value;
+        SpuRecord*         record      = &program->records[program->recordsCount];
+
+        record->immed   = instruction->immed;
+        record->nextIp  = (position + instruction->size) / unitSize;
+        record->command = instruction->command;
+        record->argType = instruction->argType;
+        record->regNum  = instruction->regNum;
+
+        ErrorCode error = _checkRecord(record);
+        if (error)
+        {
+            SpuProgramDestroy(program);
+            return error;
+        }
+
+        program->recordOf[position / unitSize] = (uint32_t)program->recordsCount++;
+        position += instruction->size;
+    }
+
+    // running off the end stops the program like hlt
+    program->records[program->recordsCount].command = CMD_HLT;
+    program->records[program->recordsCount].nextIp  = program->codeSize;
+    program->recordOf[program->codeSize] = (uint32_t)program->recordsCount;
+
+    return EVERYTHING_FINE;
+}
+
+ErrorCode SpuProgramSetEntry(SpuProgram* program, size_t entryPoint)
+{
+    MyAssertSoft(program, ERROR_NULLPTR);
+    MyAssertSoft(program->recordOf, ERROR_NULLPTR);
+
+    if (entryPoint > program->codeSize || program->recordOf[entryPoint] == SPU_NO_RECORD)
+        return ERROR_INDEX_OUT_OF_BOUNDS;
+
+    program->entryRecord = program->recordOf[entryPoint];
+
+    return EVERYTHING_FINE;
+}
+
+ErrorCode SpuProgramRun(SpuProgram* program)
+{
+    MyAssertSoft(program, ERROR_NULLPTR);
+    MyAssertSoft(program->records, ERROR_NULLPTR);
+
+    double* stackData     = (double*)calloc(SPU_STACK_CAPACITY, sizeof(*stackData));
+    double* callStackData = (double*)calloc(SPU_STACK_CAPACITY, sizeof(*callStackData));
+    double* ram           = (double*)calloc(SPU_RAM_SIZE, sizeof(*ram));
+
+    ErrorCode error = stackData && callStackData && ram ? EVERYTHING_FINE : ERROR_NO_MEMORY;
+
+    if (!error)
+        error = _execute(program, stackData, callStackData, ram);
+
+    free(stackData);
+    free(callStackData);
+    free(ram);
+
+    return error;
+}
+
+ErrorCode SpuExecuteCommand(Spu* spu, SpuRecord* record)
+{
+    MyAssertSoft(spu, ERROR_NULLPTR);
+    MyAssertSoft(record, ERROR_NULLPTR);
+
+    ArgResult argResult = {};
+    double    argTemp   = 0;
+
+    spu->ip = record->nextIp;
+
+    if (record->argType)
+    {
+        argResult = _getArg(spu, record, &argTemp);
+        RETURN_ERROR(argResult.error);
+    }
+
+    switch (record->command)
+    {
+        #define DEF_COMMAND(name, num, hasArg, ...) \
+            case num:                               \
+                __VA_ARGS__                         \
+                break;
+
+        #include "Commands.gen"
+
+        #undef DEF_COMMAND
+
+        default:
+            return ERROR_BAD_VALUE;
+    }
+
+    return EVERYTHING_FINE;
+}
+
+void SpuProgramDestroy(SpuProgram* program)
+{
+    MyAssertHard(program, ERROR_NULLPTR, );
+
+    free(program->records);
+    free(program->recordOf);
+
+    *program = {};
+}
+
+static ErrorCode _checkRecord(const SpuRecord* record)
+{
+    const CommandInfo* info = FindCommandByNumber(record->command);
+
+    if (!info || info->hasArg != (record->argType != 0))
+        return ERROR_BAD_VALUE;
+
+    if ((record->argType & RegisterArg) && record->regNum > regNum)
+        return ERROR_BAD_VALUE;
+
+    // pop writes to its argument, so it must be a register or a RAM cell
+    if (record->command == CMD_POP && record->argType != RegisterArg && !(record->argType & RAMArg))
+        return ERROR_BAD_VALUE;
+
+    return EVERYTHING_FINE;
+}
+
+static ErrorCode _execute(SpuProgram* program, double* stackData, double* callStackData, double* ram)
+{
+    // the state is local, so the compiler may keep the tops of the stacks and ip in registers
+    SpuStack stack     = {stackData,     0, SPU_STACK_CAPACITY, 0};
+    SpuStack callStack = {callStackData, 0, SPU_STACK_CAPACITY, 0};
+    Spu      state     = {&stack, &callStack, 0, {}, ram};
+    Spu*     spu       = &state;
+
+    const void* handlers[MAX_COMMANDS] = {};
+
+    #define DEF_COMMAND(name, num, ...) \
+        handlers[num] = &&EXECUTE_ ## name;
+
+    #include "Commands.gen"
+
+    #undef DEF_COMMAND
+
+    // records are threaded with addresses of the bodies, so dispatching is a single indirect jump
+    for (size_t i = 0; i <= program->recordsCount; i++)
+        program->records[i].handler = handlers[program->records[i].command];
+
+    program->records[program->recordsCount].handler = &&EXECUTE_END;
+
+    SpuRecord* record    = program->records + program->entryRecord;
+    ArgResult  argResult = {};
+    double     argTemp   = 0;
+
+    #define DISPATCH()                                                                          \
+    do                                                                                          \
+    {                                                                                           \
+        if (spu->ip == record->nextIp)                                                          \
+            record++;                                                                           \
+        else                                                                                    \
+        {                                                                                       \
+            if (spu->ip > program->codeSize || program->recordOf[spu->ip] == SPU_NO_RECORD)     \
+                return ERROR_INDEX_OUT_OF_BOUNDS;                                               \
+                                                                                                \
+            record = program->records + program->recordOf[spu->ip];                             \
+        }                                                                                       \
+        goto *record->handler;                                                                  \
+    } while (0)
+
+    #define DEF_COMMAND(name, num, hasArg, ...)                                                 \
+    EXECUTE_ ## name:                                                                           \
+    {                                                                                           \
+        spu->ip = record->nextIp;                                                               \
+                                                                                                \
+        if (hasArg)                                                                             \
+        {                                                                                       \
+            argResult = _getArg(spu, record, &argTemp);                                         \
+            RETURN_ERROR(argResult.error);                                                      \
+        }                                                                                       \
+                                                                                                \
+        __VA_ARGS__                                                                             \
+        DISPATCH();                                                                             \
+    }
+
+    goto *record->handler;
+
+    #include "Commands.gen"
+
+    #undef DEF_COMMAND
+    #undef DISPATCH
+
+EXECUTE_END:
+    return EVERYTHING_FINE;
+}
+
+static inline ArgResult _getArg(Spu* spu, SpuRecord* record, double* temp)
+{
+    switch (record->argType)
+    {
+        case ImmediateNumberArg:
+            return {&record->immed, EVERYTHING_FINE};
+        case RegisterArg:
+            return {&spu->regs[record->regNum], EVERYTHING_FINE};
+        default:
+            break;
+    }
+
+    double value = 0;
+    if (record->argType & ImmediateNumberArg)
+        value += record->immed;
+    if (record->argType & RegisterArg)
+        value += spu->regs[record->regNum];
+
+    if (!(record->argType & RAMArg))
+    {
+        *temp = value;
+        return {temp, EVERYTHING_FINE};
+    }
+
+    return GetRamCell(spu->ram, value);
+}
@@ -0,0 +1,109 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Spu.hpp"
+#include "Jit.hpp"
+#include "Aot.hpp"
+#include "Executable.hpp"
+
+static const char USAGE[] = "Usage: DugongSPU [--compact | --aligned] [--jit | --aot=executable] program\n";
+
+static ErrorCode _runFile(const char* path, CodeFormat format, bool isJit, const char* aotPath);
+
+int main(int argc, const char* const argv[])
+{
+    CodeFormat  format  = FORMAT_PLAIN;
+    const char* path    = NULL;
+    bool        isJit   = false;
+    const char* aotPath = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--compact") == 0)
+            format = FORMAT_COMPACT;
+        else if (strcmp(argv[i], "--aligned") == 0)
+            format = FORMAT_ALIGNED;
+        else if (strcmp(argv[i], "--jit") == 0)
+            isJit = true;
+        else if (strncmp(argv[i], "--aot=", sizeof("--aot=") - 1) == 0)
+            aotPath = argv[i] + sizeof("--aot=") - 1;
+        else if (strncmp(argv[i], "--", 2) == 0 || path)
+        {
+            fprintf(stderr, "Unknown option %s.\n%s", argv[i], USAGE);
+            return ERROR_BAD_VALUE;
+        }
+        else
+            path = argv[i];
+    }
+
+    if (!path)
+    {
+        fprintf(stderr, "Please, give the program.\n%s", USAGE);
+        return ERROR_BAD_FILE;
+    }
+
+    ErrorCode error = _runFile(path, format, isJit, aotPath);
+
+    if (error)
+        printf("SPU ERROR %s!!!\n", ERROR_CODE_NAMES[error]);
+
+    return error;
+}
+
+static ErrorCode _runFile(const char* path, CodeFormat format, bool isJit, const char* aotPath)
+{
+    int fd = open(path, O_RDONLY);
+    MyAssertSoft(fd != -1, ERROR_BAD_FILE);
+
+    struct stat fileStat = {};
+    MyAssertSoft(fstat(fd, &fileStat) == 0, ERROR_BAD_FILE, close(fd));
+
+    // the program is decoded straight from the mapped file
+    size_t fileSize = (size_t)fileStat.st_size;
+    void*  mapping  = fileSize ? mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+
+    MyAssertSoft(mapping != MAP_FAILED, ERROR_BAD_FILE);
+
+    const byte* code       = (const byte*)mapping;
+    size_t      codeSize   = fileSize;
+    Executable  executable = {};
+    ErrorCode   error      = EVERYTHING_FINE;
+
+    // executables know their format, bare code is taken as the options say
+    bool isExecutable = IsExecutable(code, codeSize);
+    if (isExecutable)
+    {
+        error = ReadExecutable(code, codeSize, &executable);
+
+        // the data section is reserved, no executor sets the RAM up from it
+        if (!error && executable.sizes[SECTION_DATA] != 0)
+            error = ERROR_BAD_VALUE;
+
+        format   = executable.format;
+        code     = executable.sections[SECTION_CODE];
+        codeSize = executable.sizes[SECTION_CODE];
+    }
+
+    SpuProgram program = {};
+
+    if (!error)
+        error = SpuProgramLoad(&program, code, codeSize, format);
+
+    if (!error && isExecutable)
+        error = SpuProgramSetEntry(&program, executable.entryPoint);
+
+    if (mapping)
+        munmap(mapping, fileSize);
+
+    if (!error && aotPath)
+        error = SpuProgramCompileAot(&program, aotPath);
+    else if (!error)
+        error = isJit ? SpuProgramRunJit(&program) : SpuProgramRun(&program);
+
+    SpuProgramDestroy(&program);
+
+    return error;
+}
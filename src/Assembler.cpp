@@ -1,39 +1,37 @@
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "Assembler.hpp"
 #include "OneginFunctions.hpp"
-
-#define ON_SECOND_RUN(...) if (isSecondRun) __VA_ARGS__
-
-#define FREE_JUNK fclose(binaryFile); fclose(listingFile); free(codeArray); \
-                  DestroyText(&code); for (size_t i = 0; i < MAX_LABELS; i++) free((void*)labelArray[i].label)
-
-static const size_t MAX_LABELS = 128;
-static const size_t MAX_LABEL_SIZE = 48;
-static const size_t MAX_COMMAND_LENGTH = 4;
-const size_t LABEL_NOT_FOUND = (size_t)-1;
-
-static const size_t MAX_ARGS_SIZE = sizeof(double) + 1;
-static const size_t REG_NUM_BYTE  = MAX_ARGS_SIZE - 1;
-
-typedef unsigned char byte;
-#include "SPUsettings.ini"
-
-enum Command
-{
-    #define DEF_COMMAND(name, num, ...) \
-        CMD_ ## name = num,
-
-    #include "Commands.gen"
-
-    #undef DEF_COMMAND
-};
+#include "AssemblerState.hpp"
+#include "OutputBuffer.hpp"
+#include "AssemblyCache.hpp"
+#include "ObjectFile.hpp"
+#include "Executable.hpp"
+#include "Optimizer.hpp"
+#include "Lexer.hpp"
+
+static const size_t LABELS_START_CAPACITY = 64;
+static const size_t MAX_LABELS_IN_ARG     = 2;
+static const size_t STREAM_CHUNK_SIZE     = 1 << 20;
+static const size_t MIN_LINES_PER_JOB     = 1 << 12;
+static const char   CACHE_FILE_SUFFIX[]   = ".cache";
+static const size_t MIN_LINES_PER_BLOCK   = 1 << 6;
+static const size_t MAX_LINES_PER_BLOCK   = 1 << 14;
+static const unsigned int BLOCK_BOUNDARY_MASK = 0xF;
+static const unsigned int BLOCK_HASH_SEED     = 0xB10C;
+static const size_t LISTING_BUFFER_SIZE   = 1 << 20;
+static const size_t LISTING_LINE_WIDTH    = 82;
 
 struct Arg
 {
     double immed;
     byte regNum;
     byte argType;
+    bool hasLabel;
+    size_t unresolvedLabels[MAX_LABELS_IN_ARG];
+    size_t unresolvedLabelsCount;
 };
 
 struct ArgResult
@@ -42,397 +40,1060 @@ struct ArgResult
     ErrorCode error;
 };
 
-struct CodePositionResult
+/** @struct AssemblerJob
+ * @brief Lines of the source assembled into their own state with deferred labels.
+ * Code and label positions of the job are relative to its first command, lines to its first line.
+ *
+ * @var AssemblerJob::state - what the job built.
+ * @var AssemblerJob::begin - first line of the job.
+ * @var AssemblerJob::end - line after the last one.
+ * @var AssemblerJob::hash - hash of the job's source, the key in the cache.
+ * @var AssemblerJob::isCached - whether the state was read from the cache.
+ * @var AssemblerJob::error - how assembling went.
+ */
+struct AssemblerJob
 {
-    size_t value;
+    AssemblerState state;
+    size_t   begin;
+    size_t   end;
+    uint64_t hash;
+    bool     isCached;
     ErrorCode error;
 };
 
-struct Label
+/** @struct JobQueue
+ * @brief Jobs which worker threads take one by one.
+ *
+ * @var JobQueue::jobs - the jobs.
+ * @var JobQueue::jobsCount - their number.
+ * @var JobQueue::nextJob - the first job nobody took yet.
+ * @var JobQueue::code - the source.
+ * @var JobQueue::allocations - arrays grown by the started threads.
+ */
+struct JobQueue
 {
-    const char* label;
-    double codePosition;
+    AssemblerJob* jobs;
+    size_t        jobsCount;
+    size_t        nextJob;
+    const Text*   code;
+    size_t        allocations;
 };
 
-static ErrorCode _proccessToken(byte* codeArray, size_t* codePosition,
-                               Label labelArray[], size_t* freeLabelCell,
-                               String* curToken, FILE* listingFile,
-                               bool isSecondRun);
+static ErrorCode _compileText(AssemblerState* state, const char* codeFilePath, const char* cachePath,
+                              const CompileOptions* options, FILE* binaryFile, OutputBuffer* listing);
 
-static ErrorCode _insertLabel(Label* labelArray, size_t* freeLabelCell, const String* curToken,
-                              const char* labelEnd, size_t codePosition);
+static ErrorCode _compileStream(AssemblerState* state, const char* codeFilePath,
+                                FILE* binaryFile, OutputBuffer* listing);
 
-static ArgResult _parseArg(const char* argStr, const Label labelArray[], bool isSecondRun);
+static ErrorCode _assemble(AssemblerState* state, const Text* code, size_t begin, size_t end, size_t firstLine);
 
-static ArgResult _parseReg(const char** argStr);
+static ErrorCode _assembleParallel(AssemblerState* state, const Text* code, size_t threadsCount);
 
-static ArgResult _parseImmed(const char** argStr);
+static ErrorCode _assembleCached(AssemblerState* state, const Text* code, size_t threadsCount, const char* cachePath);
 
-static ArgResult _parseLabel(const char** argStr, bool isSecondRun, const Label labelArray[]);
+static ErrorCode _splitBlocks(const Text* code, AssemblerJob** jobs, size_t* jobsCount);
 
-static ArgResult _parseImmedLabel(const char** argStr, const Label labelArray[], bool isSecondRun);
+static void _setJobSettings(const AssemblerState* state, AssemblerJob* job);
 
-static CodePositionResult _getLabelCodePosition(const Label labelArray[], const char* label);
+static ErrorCode _runJobs(AssemblerState* state, const Text* code, AssemblerJob* jobs, size_t jobsCount,
+                          size_t threadsCount);
 
-static byte _translateCommandToBinFormat(Command command, byte argType);
+static void* _jobWorker(void* queue);
 
-// too many args to be a separate function
-#define RUN_COMPILATION(isSecondRun)                                                                            \
-    codePosition = 0;                                                                                           \
-    for (size_t tokenIndex = 0; tokenIndex < code.numberOfTokens; tokenIndex++)                                 \
-    {                                                                                                           \
-        const String* curToken = &code.tokens[tokenIndex];                                                      \
-                                                                                                                \
-        ErrorCode proccessError = _proccessToken(codeArray, &codePosition, labelArray, &freeLabelCell,          \
-                                               (String*)curToken, listingFile, isSecondRun);                    \
-                                                                                                                \
-        if (proccessError)                                                                                      \
-        {                                                                                                       \
-            SetConsoleColor(stdout, COLOR_RED);                                                                 \
-            printf("%s in line #%zu: \"%s\"\n", ERROR_CODE_NAMES[proccessError], tokenIndex, curToken->text);   \
-            SetConsoleColor(stdout, COLOR_WHITE);                                                               \
-            FREE_JUNK;                                                                                          \
-            return proccessError;                                                                               \
-        }                                                                                                       \
-    }
+static void* _jobThread(void* queue);
+
+static void _destroyJobs(AssemblerJob* jobs, size_t jobsCount);
+
+static ErrorCode _proccessToken(AssemblerState* state, const String* curToken, const TokenMarks* marks,
+                                size_t tokenIndex);
+
+static ErrorCode _resolveFixups(AssemblerState* state, const Text* code);
+
+static ErrorCode _resolveBufferedFixups(AssemblerState* state);
+
+static ErrorCode _resolveFlushedFixups(AssemblerState* state, FILE* binaryFile);
 
-ErrorCode Compile(const char* codeFilePath, const char* binaryFilePath, const char* listingFilePath)
+static ErrorCode _patchImmediate(const AssemblerState* state, byte* immediate, const Fixup* fixup);
+
+static void _writeListingLines(const AssemblerState* state, const Text* code, size_t firstLine, OutputBuffer* listing);
+
+static void _writeListingLabels(const AssemblerState* state, OutputBuffer* listing);
+
+static void _printLineError(const AssemblerState* state, ErrorCode error, size_t tokenIndex,
+                            const String* curToken);
+
+static ErrorCode _insertLabel(LabelTable* labels, const String* line,
+                              const char* labelEnd, size_t codePosition);
+
+static ArgResult _parseArg(Lexer* lexer, AssemblerState* state);
+
+static ArgResult _parseOperand(const Lexeme* lexeme, AssemblerState* state, bool allowRegister);
+
+static ArgResult _parseLabel(const Lexeme* lexeme, AssemblerState* state);
+
+ErrorCode Compile(const char* codeFilePath, const char* binaryFilePath, const char* listingFilePath,
+                  const CompileOptions* options)
 {
     MyAssertSoft(codeFilePath, ERROR_NULLPTR);
     MyAssertSoft(binaryFilePath, ERROR_NULLPTR);
-    MyAssertSoft(listingFilePath, ERROR_NULLPTR);
 
-    FILE* binaryFile = fopen(binaryFilePath, "wb");
+    CompileOptions defaultOptions = {};
+    if (!options)
+        options = &defaultOptions;
+
+    CompileStats* stats = options->stats;
+    if (stats)
+        *stats = {};
+
+    double compileStart     = CompileStatsStart(stats);
+    size_t allocationsStart = GrowArrayCount();
+
+    // objects and executables are written and optimized only once the whole module is assembled
+    MyAssertSoft(!options->stream || (!options->object && !options->optimize && !options->container),
+                 ERROR_BAD_VALUE);
+    bool stream = options->stream;
+
+    // the stream reads flushed immediates back to patch them
+    FILE* binaryFile = fopen(binaryFilePath, stream ? "w+b" : "wb");
     MyAssertSoft(binaryFile, ERROR_BAD_FILE);
 
-    FILE* listingFile  = fopen(listingFilePath,  "w");
-    MyAssertSoft(listingFile, ERROR_BAD_FILE);
+    FILE* listingFile = NULL;
+    if (listingFilePath)
+    {
+        listingFile = fopen(listingFilePath, "w");
+        MyAssertSoft(listingFile, ERROR_BAD_FILE, fclose(binaryFile));
+    }
 
-    Text code = CreateText(codeFilePath, '\n');
+    AssemblerState state = {};
+    state.format       = options->aligned ? FORMAT_ALIGNED : options->compact ? FORMAT_COMPACT : FORMAT_PLAIN;
+    state.writeListing = listingFile != NULL;
+    // the optimizer moves code, so every label reference is kept as a fixup until it is done
+    state.deferLabels  = options->object || options->optimize;
+    // the optimizer works on the parsed commands, so they are kept besides the code
+    state.collectIr    = options->optimize;
+    state.diagnostics  = options->diagnostics ? options->diagnostics : stdout;
+    state.stats        = stats;
+
+    // the stream reuses its buffer and cached labels live in the cache, so labels can't keep views of them
+    ErrorCode error = LabelTableInit(&state.labels, LABELS_START_CAPACITY, stream || options->cache);
+
+    char* cachePath = NULL;
+    if (!error && options->cache && !stream)
+    {
+        cachePath = (char*)calloc(strlen(binaryFilePath) + sizeof(CACHE_FILE_SUFFIX), sizeof(*cachePath));
+        if (cachePath)
+        {
+            strcpy(cachePath, binaryFilePath);
+            strcat(cachePath, CACHE_FILE_SUFFIX);
+        }
+        else
+            error = ERROR_NO_MEMORY;
+    }
 
-    byte* codeArray = (byte*)calloc(code.numberOfTokens, sizeof(double) + 2);
+    OutputBuffer  listingBuffer = {};
+    OutputBuffer* listing       = NULL;
 
-    Label  labelArray[MAX_LABELS] = {};
-    size_t freeLabelCell = 0;
+    if (!error && listingFile)
+    {
+        error   = OutputBufferInit(&listingBuffer, listingFile, LISTING_BUFFER_SIZE);
+        listing = &listingBuffer;
 
-    size_t codePosition = 0;
-    RUN_COMPILATION(false);
+        OutputBufferPrintf(listing, "Code position:%20s cmd:%4s arg:%24s original:\n", "", "", "");
+    }
 
-    fprintf(listingFile, "Code position:%20s cmd:%4s arg:%24s original:\n", "", "", "");
+    if (!error)
+    {
+        if (stream)
+            error = _compileStream(&state, codeFilePath, binaryFile, listing);
+        else
+            error = _compileText(&state, codeFilePath, cachePath, options, binaryFile, listing);
+    }
 
-    RUN_COMPILATION(true);
+    double phaseStart = CompileStatsStart(stats);
 
-    fprintf(listingFile, "\nLabel array:\n");
-    for (size_t i = 0; i < freeLabelCell; i++)
+    if (listing)
     {
-        fprintf(listingFile, "[%zu]\n", i);
-        fprintf(listingFile, "{\n%4scodePosition = %lg\n", "", labelArray[i].codePosition);
-        fprintf(listingFile, "%4slabel = %s\n}\n", "", labelArray[i].label);
+        ErrorCode listingError = OutputBufferDestroy(listing);
+        if (!error)
+            error = listingError;
     }
 
-    fwrite(codeArray, codePosition, sizeof(*codeArray), binaryFile);
+    if (listingFile)
+        fclose(listingFile);
 
-    FREE_JUNK;
+    CompileStatsStop(stats, PHASE_LISTING, phaseStart);
 
-    return EVERYTHING_FINE;
+    phaseStart = CompileStatsStart(stats);
+    fclose(binaryFile);
+    CompileStatsStop(stats, PHASE_WRITE, phaseStart);
+
+    if (stats)
+    {
+        stats->instructions = state.commandsCount;
+        stats->labels       = state.labels.size;
+        stats->labelLookups = state.labels.lookups;
+        stats->labelProbes  = state.labels.probes;
+        stats->bytesEmitted = state.codePosition;
+        stats->allocations  = GrowArrayCount() - allocationsStart + state.allocations;
+    }
+
+    DestroyAssemblerState(&state);
+    free(cachePath);
+
+    if (stats)
+        stats->totalTime = CompileStatsStart(stats) - compileStart;
+
+    return error;
 }
 
-static ErrorCode _proccessToken(byte* codeArray, size_t* codePosition,
-                               Label labelArray[], size_t* freeLabelCell,
-                               String* curToken, FILE* listingFile,
-                               bool isSecondRun)
+static ErrorCode _compileText(AssemblerState* state, const char* codeFilePath, const char* cachePath,
+                              const CompileOptions* options, FILE* binaryFile, OutputBuffer* listing)
 {
-    ((char*)curToken->text)[curToken->length] = '\0';
+    double phaseStart = CompileStatsStart(state->stats);
 
-    char* commentPtr = (char*)strchr(curToken->text, ';');
-    if (commentPtr)
-        *commentPtr = '\0';
+    Text code = CreateTextMapped(codeFilePath, '\n');
+    MyAssertSoft(code.rawText, ERROR_BAD_FILE);
 
-    if (StringIsEmptyChars(curToken->text, '\0'))
-        return EVERYTHING_FINE;
+    CompileStatsStop(state->stats, PHASE_READ, phaseStart);
+
+    if (state->stats)
+        state->stats->lines = code.numberOfTokens;
+
+    ErrorCode error = EVERYTHING_FINE;
 
-    const char* labelEnd = strchr(curToken->text, ':');
-    if (labelEnd)
+    phaseStart = CompileStatsStart(state->stats);
+
+    if (cachePath)
+        error = _assembleCached(state, &code, options->jobs, cachePath);
+    else if (options->jobs > 1)
+        error = _assembleParallel(state, &code, options->jobs);
+    else
     {
-        if (isSecondRun)
+        error = GrowArray((void**)&state->codeArray, &state->codeCapacity,
+                           code.numberOfTokens * MAX_INSTRUCTION_SIZE, sizeof(*state->codeArray));
+
+        if (!error && state->collectIr)
+            error = CodeIrReserve(&state->ir, code.numberOfTokens);
+
+        if (!error)
         {
-            if (commentPtr)
-                *commentPtr = ';';
-            fprintf(listingFile, "%82s%s\n", "", curToken->text);
-            if (commentPtr)
-                *commentPtr = '\0';
-            return EVERYTHING_FINE;
+            error = _assemble(state, &code, 0, code.numberOfTokens, 0);
+            if (error)
+                _printLineError(state, error, state->errorLine, &code.tokens[state->errorLine]);
         }
+    }
+
+    CompileStatsStop(state->stats, PHASE_ASSEMBLE, phaseStart);
+
+    phaseStart = CompileStatsStart(state->stats);
+
+    if (!error && options->optimize)
+        error = OptimizeCode(state, options->object, options->fuse);
+
+    CompileStatsStop(state->stats, PHASE_OPTIMIZE, phaseStart);
+
+    phaseStart = CompileStatsStart(state->stats);
+
+    // labels of an object are resolved by the linker
+    if (!error && !options->object)
+        error = _resolveFixups(state, &code);
+
+    CompileStatsStop(state->stats, PHASE_RESOLVE, phaseStart);
 
-        if (labelEnd)
+    if (!error)
+    {
+        phaseStart = CompileStatsStart(state->stats);
+
+        if (listing)
         {
-            ErrorCode labelError = _insertLabel(labelArray, freeLabelCell, curToken, labelEnd, *codePosition);
-            return labelError;
+            _writeListingLines(state, &code, 0, listing);
+            _writeListingLabels(state, listing);
         }
+
+        CompileStatsStop(state->stats, PHASE_LISTING, phaseStart);
+
+        phaseStart = CompileStatsStart(state->stats);
+
+        if (options->object)
+            error = WriteObjectFile(binaryFile, state);
+        else if (options->container)
+            error = WriteExecutable(binaryFile, state->format, state->codeArray, state->codePosition, &state->labels);
+        else if (state->codePosition)
+            fwrite(state->codeArray, state->codePosition, sizeof(*state->codeArray), binaryFile);
+
+        CompileStatsStop(state->stats, PHASE_WRITE, phaseStart);
     }
 
-    char command[MAX_COMMAND_LENGTH + 1] = "";
-    int commandLength = 0;
+    DestroyText(&code);
 
-    if (sscanf(curToken->text, "%4s%n", command, &commandLength) != 1)
-        return ERROR_SYNTAX;
+    return error;
+}
+
+static ErrorCode _compileStream(AssemblerState* state, const char* codeFilePath,
+                                FILE* binaryFile, OutputBuffer* listing)
+{
+    FILE* codeFile = fopen(codeFilePath, "rb");
+    MyAssertSoft(codeFile, ERROR_BAD_FILE);
+
+    char*  chunk         = NULL;
+    size_t chunkCapacity = 0;
+    size_t chunkSize     = 0;
+    size_t firstLine     = 0;
+    bool   isLastChunk   = false;
+
+    ErrorCode error = EVERYTHING_FINE;
+
+    while (!error && !isLastChunk)
+    {
+        double phaseStart = CompileStatsStart(state->stats);
+
+        // a line which doesn't fit makes the chunk grow
+        error = GrowArray((void**)&chunk, &chunkCapacity, chunkSize + STREAM_CHUNK_SIZE, sizeof(*chunk));
+        if (error)
+            break;
+
+        size_t toRead = chunkCapacity - chunkSize;
+        size_t read   = fread(chunk + chunkSize, sizeof(*chunk), toRead, codeFile);
+
+        chunkSize  += read;
+        isLastChunk = read < toRead;
+
+        size_t linesSize = chunkSize;
+        if (!isLastChunk)
+        {
+            const char* lastTerminator = (const char*)memrchr(chunk, '\n', chunkSize);
+            if (!lastTerminator)
+                continue;
+
+            linesSize = (size_t)(lastTerminator - chunk) + 1;
+        }
 
-    #define DEF_COMMAND(name, num, hasArg, ...)                                             \
-    if (strcasecmp(command, #name) == 0)                                                    \
-    {                                                                                       \
-        ON_SECOND_RUN(fprintf(listingFile, "%13s [0x%016lX] %4s", "",                       \
-                             *codePosition, ""));                                           \
-                                                                                            \
-        if (hasArg)                                                                         \
-        {                                                                                   \
-            ArgResult argRes = _parseArg(curToken->text + commandLength + 1,                 \
-                                         labelArray, isSecondRun);                          \
-            RETURN_ERROR(argRes.error);                                                     \
-                                                                                            \
-            Arg arg = argRes.value;                                                         \
-                                                                                            \
-            byte cmd = _translateCommandToBinFormat(CMD_ ## name, arg.argType);             \
-            memcpy(codeArray + (*codePosition)++, &cmd, 1);                                 \
-                                                                                            \
-            if (arg.argType & ImmediateNumberArg)                                           \
-            {                                                                               \
-                memcpy(codeArray + *codePosition, &arg.immed, sizeof(double));              \
-                *codePosition += sizeof(double);                                            \
-            }                                                                               \
-            if (arg.argType & RegisterArg)                                                  \
-            {                                                                               \
-                memcpy(codeArray + *codePosition, &arg.regNum, 1);                          \
-                *codePosition += 1;                                                         \
-            }                                                                               \
-                                                                                            \
-            ON_SECOND_RUN(fprintf(listingFile, "0x%02hX %4s", cmd, ""));                    \
-            ON_SECOND_RUN(fprintf(listingFile, "0x%016lX 0x%02hhX %10s",                    \
-                                  *(uint64_t*)&arg.immed, arg.regNum, ""));                 \
-        }                                                                                   \
-        else                                                                                \
-        {                                                                                   \
-            byte cmd = (byte)CMD_ ## name;                                                  \
-            memcpy(codeArray + (*codePosition)++, &cmd, 1);                                 \
-            ON_SECOND_RUN(fprintf(listingFile, "0x%02hX %38s", cmd, ""));                   \
-        }                                                                                   \
-    }                                                                                       \
-    else 
-
-    #include "Commands.gen"
-
-    /*else*/ return ERROR_SYNTAX;
-
-    #undef DEF_COMMAND
-
-    if (commentPtr)
-        *commentPtr = ';';
-
-    ON_SECOND_RUN(fprintf(listingFile, "%s\n", curToken->text));
+        // the terminator of the last complete line starts the next chunk's first line
+        Text code = CreateTextFromBuffer(chunk, isLastChunk ? linesSize : linesSize - 1, '\n');
+
+        CompileStatsStop(state->stats, PHASE_READ, phaseStart);
+
+        if (state->stats)
+            state->stats->lines += code.numberOfTokens;
+
+        phaseStart = CompileStatsStart(state->stats);
+
+        error = GrowArray((void**)&state->codeArray, &state->codeCapacity,
+                           code.numberOfTokens * MAX_INSTRUCTION_SIZE, sizeof(*state->codeArray));
+
+        if (!error)
+        {
+            error = _assemble(state, &code, 0, code.numberOfTokens, firstLine);
+            if (error)
+                _printLineError(state, error, state->errorLine, &code.tokens[state->errorLine - firstLine]);
+        }
+
+        CompileStatsStop(state->stats, PHASE_ASSEMBLE, phaseStart);
+
+        phaseStart = CompileStatsStart(state->stats);
+
+        if (!error)
+            error = _resolveBufferedFixups(state);
+
+        CompileStatsStop(state->stats, PHASE_RESOLVE, phaseStart);
+
+        if (!error)
+        {
+            phaseStart = CompileStatsStart(state->stats);
+
+            if (listing)
+                _writeListingLines(state, &code, firstLine, listing);
+
+            CompileStatsStop(state->stats, PHASE_LISTING, phaseStart);
+
+            phaseStart = CompileStatsStart(state->stats);
+
+            fwrite(state->codeArray, state->codePosition - state->codeBase, sizeof(*state->codeArray), binaryFile);
+
+            CompileStatsStop(state->stats, PHASE_WRITE, phaseStart);
+
+            state->codeBase      = state->codePosition;
+            state->listingCount  = 0;
+            state->flushedFixups = state->fixupsCount;
+        }
+
+        firstLine += code.numberOfTokens;
+        DestroyText(&code);
+
+        memmove(chunk, chunk + linesSize, chunkSize - linesSize);
+        chunkSize -= linesSize;
+    }
+
+    if (!error && ferror(codeFile))
+        error = ERROR_BAD_FILE;
+
+    double phaseStart = CompileStatsStart(state->stats);
+
+    if (!error)
+        error = _resolveFlushedFixups(state, binaryFile);
+
+    CompileStatsStop(state->stats, PHASE_RESOLVE, phaseStart);
+
+    phaseStart = CompileStatsStart(state->stats);
+
+    if (!error && listing)
+        _writeListingLabels(state, listing);
+
+    CompileStatsStop(state->stats, PHASE_LISTING, phaseStart);
+
+    free(chunk);
+    fclose(codeFile);
+
+    return error;
+}
+
+static ErrorCode _assemble(AssemblerState* state, const Text* code, size_t begin, size_t end, size_t firstLine)
+{
+    for (size_t tokenIndex = begin; tokenIndex < end; tokenIndex++)
+    {
+        size_t line = firstLine + (tokenIndex - begin);
+
+        ErrorCode proccessError = _proccessToken(state, &code->tokens[tokenIndex], &code->marks[tokenIndex], line);
+
+        if (proccessError)
+        {
+            state->errorLine = line;
+            return proccessError;
+        }
+    }
 
     return EVERYTHING_FINE;
 }
 
-static ArgResult _parseArg(const char* argStr, const Label labelArray[], bool isSecondRun)
+static ErrorCode _assembleParallel(AssemblerState* state, const Text* code, size_t threadsCount)
 {
-    MyAssertSoftResult(argStr,     {}, ERROR_NULLPTR);
-    MyAssertSoftResult(labelArray, {}, ERROR_NULLPTR);
+    // small jobs cost more in merging than they save
+    size_t jobsCount    = threadsCount;
+    size_t maxJobsCount = (code->numberOfTokens + MIN_LINES_PER_JOB - 1) / MIN_LINES_PER_JOB;
+    if (jobsCount > maxJobsCount)
+        jobsCount = maxJobsCount ? maxJobsCount : 1;
+
+    AssemblerJob* jobs = (AssemblerJob*)calloc(jobsCount, sizeof(*jobs));
+    MyAssertSoft(jobs, ERROR_NO_MEMORY);
+
+    ErrorCode error = EVERYTHING_FINE;
 
-    const char* bracketPtr = strchr(argStr, '[');
-    char* backBracketPtr   = (char*)strchr(argStr, ']');
-    if (bracketPtr || backBracketPtr)
+    for (size_t i = 0; i < jobsCount && !error; i++)
     {
-        if (!(bracketPtr && backBracketPtr))
-            return {{}, ERROR_SYNTAX};
+        jobs[i].begin = code->numberOfTokens *  i      / jobsCount;
+        jobs[i].end   = code->numberOfTokens * (i + 1) / jobsCount;
 
-        *backBracketPtr = '\0';
-        
-        argStr = bracketPtr + 1;
+        _setJobSettings(state, &jobs[i]);
+        error = LabelTableInit(&jobs[i].state.labels, LABELS_START_CAPACITY, false);
     }
 
-    char* plusPtr = (char*)strchr(argStr, '+');
-    if (plusPtr)
-        *plusPtr = '\0';
+    if (!error)
+        error = _runJobs(state, code, jobs, jobsCount, threadsCount);
 
-    ArgResult argRes = {};
+    _destroyJobs(jobs, jobsCount);
+
+    return error;
+}
+
+static ErrorCode _assembleCached(AssemblerState* state, const Text* code, size_t threadsCount, const char* cachePath)
+{
+    AssemblerJob* jobs      = NULL;
+    size_t        jobsCount = 0;
 
+    ErrorCode error = _splitBlocks(code, &jobs, &jobsCount);
+
+    AssemblyCache cache = {};
+    if (!error)
+        error = AssemblyCacheOpen(&cache, cachePath, state->format);
+
+    for (size_t i = 0; i < jobsCount && !error; i++)
     {
-        ArgResult regRes = _parseReg(&argStr);
-        if (!regRes.error)
-            argRes = regRes;
-        else
+        AssemblerJob* job = &jobs[i];
+
+        // blocks are cached with listing lines, so a later compilation may want a listing
+        _setJobSettings(state, job);
+        job->state.writeListing = true;
+
+        size_t      cachedSize = 0;
+        const byte* cached     = AssemblyCacheFind(&cache, job->hash, &cachedSize);
+
+        // the cache keeps blocks encoded, so their IR is decoded from the code
+        if (cached && !ReadAssembledBlock(cached, cachedSize, &job->state) &&
+            (!state->collectIr || !BuildCodeIr(&job->state)))
         {
-            argRes = _parseImmedLabel(&argStr, labelArray, isSecondRun);
-            RETURN_ERROR_RESULT(argRes, {});
+            job->isCached = true;
+            continue;
         }
+
+        DestroyAssemblerState(&job->state);
+        job->state = {};
+
+        _setJobSettings(state, job);
+        job->state.writeListing = true;
+
+        error = LabelTableInit(&job->state.labels, LABELS_START_CAPACITY, false);
     }
 
-    if (plusPtr)
+    if (!error)
+        error = _runJobs(state, code, jobs, jobsCount, threadsCount ? threadsCount : 1);
+
+    // names of cached labels are views into the old cache, so the new one is written before it is closed
+    if (!error)
     {
-        *plusPtr = '+';
-        argStr = plusPtr + 1;
-        ArgResult immOrLabelRes = _parseImmedLabel(&argStr, labelArray, isSecondRun);
+        AssemblyCacheWriter writer = {};
+        error = AssemblyCacheWriterOpen(&writer, cachePath, state->format);
 
-        RETURN_ERROR_RESULT(immOrLabelRes, {});
+        for (size_t i = 0; i < jobsCount && !error; i++)
+            error = AssemblyCacheWriterAdd(&writer, jobs[i].hash, &jobs[i].state);
 
-        argRes.value.immed += immOrLabelRes.value.immed;
+        if (writer.file)
+        {
+            ErrorCode closeError = AssemblyCacheWriterClose(&writer, !error);
+            if (!error)
+                error = closeError;
+        }
     }
 
-    if (backBracketPtr)
+    AssemblyCacheClose(&cache);
+    _destroyJobs(jobs, jobsCount);
+
+    return error;
+}
+
+static ErrorCode _splitBlocks(const Text* code, AssemblerJob** jobs, size_t* jobsCount)
+{
+    AssemblerJob* blocks         = NULL;
+    size_t        blocksCount    = 0;
+    size_t        blocksCapacity = 0;
+
+    size_t begin = 0;
+
+    for (size_t end = 1; end <= code->numberOfTokens; end++)
     {
-        argRes.value.argType |= RAMArg;
-        *backBracketPtr = ']';
-        if (!StringIsEmptyChars(backBracketPtr + 1, 0))
-            return {{}, ERROR_SYNTAX};
+        bool isLast = end == code->numberOfTokens;
+
+        if (!isLast)
+        {
+            const TokenMarks* marks = &code->marks[end];
+
+            // blocks start at labels picked by their names, so an edit moves only the boundaries around it
+            bool isBoundary = end - begin >= MAX_LINES_PER_BLOCK ||
+                              (end - begin >= MIN_LINES_PER_BLOCK && marks->label < marks->comment &&
+                               (CalculateHash(code->tokens[end].text, marks->label, BLOCK_HASH_SEED) &
+                                BLOCK_BOUNDARY_MASK) == 0);
+
+            if (!isBoundary)
+                continue;
+        }
+
+        ErrorCode error = GrowArray((void**)&blocks, &blocksCapacity, blocksCount + 1, sizeof(*blocks));
+        MyAssertSoft(!error, error, free(blocks));
+
+        const char* blockStart = code->tokens[begin].text;
+        const char* blockEnd   = code->tokens[end - 1].text + code->tokens[end - 1].length;
+
+        AssemblerJob* block = &blocks[blocksCount++];
+        *block = {};
+
+        block->begin = begin;
+        block->end   = end;
+        block->hash  = CalculateHash64(blockStart, (size_t)(blockEnd - blockStart), BLOCK_HASH_SEED);
+
+        begin = end;
     }
 
-    if (argRes.value.argType == 0 || argRes.value.argType == RAMArg)
-        return {{}, ERROR_SYNTAX};
+    *jobs      = blocks;
+    *jobsCount = blocksCount;
 
-    argRes.error = EVERYTHING_FINE;
+    return EVERYTHING_FINE;
+}
 
-    return argRes;
+static void _setJobSettings(const AssemblerState* state, AssemblerJob* job)
+{
+    // positions of labels from other jobs are unknown, so all references are patched after merging
+    job->state.format       = state->format;
+    job->state.deferLabels  = true;
+    job->state.writeListing = state->writeListing;
+    job->state.collectIr    = state->collectIr;
 }
 
-static ArgResult _parseReg(const char** argStr)
+static ErrorCode _runJobs(AssemblerState* state, const Text* code, AssemblerJob* jobs, size_t jobsCount,
+                          size_t threadsCount)
 {
-    ArgResult argRes = {};
-    int regType = 0, readChars = 0;
+    JobQueue queue = {jobs, jobsCount, 0, code, 0};
 
-    if (sscanf(*argStr, "r%c%n", (char*)&regType, &readChars) == 1 && (*argStr)[readChars] == 'x' &&
-                                                                        StringIsEmptyChars(*argStr + readChars + 1, '\0'))
+    size_t uncachedCount = 0;
+    for (size_t i = 0; i < jobsCount; i++)
+        uncachedCount += !jobs[i].isCached;
+
+    if (threadsCount > uncachedCount)
+        threadsCount = uncachedCount;
+
+    pthread_t* threads = NULL;
+    if (threadsCount > 1)
+    {
+        threads = (pthread_t*)calloc(threadsCount - 1, sizeof(*threads));
+        MyAssertSoft(threads, ERROR_NO_MEMORY);
+    }
+
+    size_t startedCount = 0;
+    for (; startedCount + 1 < threadsCount; startedCount++)
+        if (pthread_create(&threads[startedCount], NULL, _jobThread, &queue) != 0)
+            break;
+
+    // the main thread works too, it also takes the jobs of threads which failed to start
+    _jobWorker(&queue);
+
+    for (size_t i = 0; i < startedCount; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+
+    state->allocations += queue.allocations;
+
+    ErrorCode error = EVERYTHING_FINE;
+
+    // the first failed job has the line where a single thread would stop
+    for (size_t i = 0; i < jobsCount && !error; i++)
     {
-        readChars += 1;
-        argRes.value.argType |= RegisterArg;
-        argRes.value.regNum   = regType -'a' + 1;
-        argRes.error          = EVERYTHING_FINE;
+        const AssemblerJob* job = &jobs[i];
 
-        *argStr += readChars;
+        if (job->error)
+        {
+            size_t errorLine = job->begin + job->state.errorLine;
 
-        return argRes;
+            error = job->error;
+            _printLineError(state, error, errorLine, &code->tokens[errorLine]);
+        }
+        else
+            error = MergeAssemblerState(state, &job->state, job->begin);
     }
-    else
-        return {{}, ERROR_SYNTAX};
+
+    return error;
 }
 
-static ArgResult _parseImmed(const char** argStr)
+static void* _jobWorker(void* queue)
 {
-    ArgResult argRes = {};
+    JobQueue* jobQueue = (JobQueue*)queue;
+
+    while (true)
+    {
+        size_t jobIndex = __atomic_fetch_add(&jobQueue->nextJob, 1, __ATOMIC_RELAXED);
+        if (jobIndex >= jobQueue->jobsCount)
+            break;
 
-    int readChars = 0;
+        AssemblerJob*   job   = &jobQueue->jobs[jobIndex];
+        AssemblerState* state = &job->state;
 
-    double immed = 0;
+        if (job->isCached)
+            continue;
 
-    if (sscanf(*argStr, "%lg%n", &immed, &readChars) == 1 && StringIsEmptyChars(*argStr + readChars, '\0'))
+        job->error = GrowArray((void**)&state->codeArray, &state->codeCapacity,
+                               (job->end - job->begin) * MAX_INSTRUCTION_SIZE, sizeof(*state->codeArray));
+
+        if (!job->error)
+            job->error = _assemble(state, jobQueue->code, job->begin, job->end, 0);
+    }
+
+    return NULL;
+}
+
+static void* _jobThread(void* queue)
+{
+    _jobWorker(queue);
+
+    // the counter of a new thread starts at 0
+    __atomic_fetch_add(&((JobQueue*)queue)->allocations, GrowArrayCount(), __ATOMIC_RELAXED);
+
+    return NULL;
+}
+
+static void _destroyJobs(AssemblerJob* jobs, size_t jobsCount)
+{
+    for (size_t i = 0; i < jobsCount; i++)
+        DestroyAssemblerState(&jobs[i].state);
+
+    free(jobs);
+}
+
+static ErrorCode _proccessToken(AssemblerState* state, const String* curToken, const TokenMarks* marks,
+                                size_t tokenIndex)
+{
+    String line = {curToken->text, marks->comment};
+
+    if (StringIsEmptyChars(&line))
+        return EVERYTHING_FINE;
+
+    ListingLine* listingLine = NULL;
+    if (state->writeListing)
     {
-        argRes.value.argType |= ImmediateNumberArg;
-        argRes.value.immed   += immed;
-        argRes.error          = EVERYTHING_FINE;
+        RETURN_ERROR(GrowArray((void**)&state->listing, &state->listingCapacity,
+                                state->listingCount + 1, sizeof(*state->listing)));
 
-        argStr += readChars;
+        listingLine  = &state->listing[state->listingCount++];
+        *listingLine = {tokenIndex, state->codePosition, NULL};
+    }
+
+    if (marks->label < marks->comment)
+        return _insertLabel(&state->labels, &line, line.text + marks->label, state->codePosition);
+
+    Lexer  lexer    = CreateLexer(&line);
+    Lexeme mnemonic = LexerNext(&lexer);
+
+    if (mnemonic.type != LEXEME_MNEMONIC)
+        return ERROR_SYNTAX;
 
-        return argRes;
+    const CommandInfo* commandInfo = FindCommand(mnemonic.text.text, mnemonic.text.length);
+    if (!commandInfo)
+        return ERROR_SYNTAX;
+
+    if (listingLine)
+        listingLine->commandInfo = commandInfo;
+
+    state->commandsCount++;
+
+    Instruction instruction = {(byte)commandInfo->command, 0, 0, 0, IMMEDIATE_DOUBLE, 0};
+    Arg arg = {};
+
+    if (commandInfo->hasArg)
+    {
+        ArgResult argRes = _parseArg(&lexer, state);
+        RETURN_ERROR(argRes.error);
+
+        arg = argRes.value;
+
+        instruction.argType = arg.argType;
+        instruction.regNum  = arg.regNum;
+        instruction.immed   = arg.immed;
+
+        if (state->format == FORMAT_COMPACT)
+            instruction.width = ChooseImmediateWidth(arg.immed, arg.hasLabel);
     }
-    else
-        return {{}, ERROR_SYNTAX};
+
+    size_t immedOffset = 0;
+    size_t size = EncodeInstruction(state->codeArray + (state->codePosition - state->codeBase),
+                                    &instruction, state->format, &immedOffset);
+
+    bool hasFixups = (instruction.argType & ImmediateNumberArg) && arg.unresolvedLabelsCount;
+
+    if (state->collectIr)
+    {
+        instruction.size = size;
+        RETURN_ERROR(CodeIrAppend(&state->ir, &instruction, hasFixups ? arg.unresolvedLabelsCount : 0));
+    }
+
+    if (hasFixups)
+    {
+        RETURN_ERROR(GrowArray((void**)&state->fixups, &state->fixupsCapacity,
+                                state->fixupsCount + arg.unresolvedLabelsCount, sizeof(*state->fixups)));
+
+        for (size_t i = 0; i < arg.unresolvedLabelsCount; i++)
+            state->fixups[state->fixupsCount++] = {state->codePosition + immedOffset, arg.unresolvedLabels[i],
+                                                   tokenIndex, instruction.width};
+    }
+
+    state->codePosition += size;
+
+    return EVERYTHING_FINE;
 }
 
-static ArgResult _parseLabel(const char** argStr, bool isSecondRun, const Label labelArray[])
+static ErrorCode _resolveFixups(AssemblerState* state, const Text* code)
 {
-    ArgResult argRes = {};
+    for (size_t i = 0; i < state->fixupsCount; i++)
+    {
+        const Fixup* fixup = &state->fixups[i];
+        const Label* label = &state->labels.labels[fixup->labelIndex];
 
-    int readChars = 0;
+        if (!label->isDefined)
+        {
+            _printLineError(state, ERROR_SYNTAX, fixup->tokenIndex, &code->tokens[fixup->tokenIndex]);
+            return ERROR_SYNTAX;
+        }
 
-    char label[MAX_LABEL_SIZE] = "";
+        ErrorCode patchError = _patchImmediate(state, state->codeArray + (fixup->codePosition - state->codeBase), fixup);
+        if (patchError)
+        {
+            _printLineError(state, patchError, fixup->tokenIndex, &code->tokens[fixup->tokenIndex]);
+            return patchError;
+        }
+    }
 
-    sscanf(*argStr, "%s%n", label, &readChars);
+    state->fixupsCount = 0;
 
-    CodePositionResult labelCodePostitionResult = _getLabelCodePosition(labelArray, label);
+    return EVERYTHING_FINE;
+}
 
-    RETURN_ERROR_RESULT(labelCodePostitionResult, {});
+static ErrorCode _resolveBufferedFixups(AssemblerState* state)
+{
+    size_t pendingCount = state->flushedFixups;
 
-    if (labelCodePostitionResult.value != LABEL_NOT_FOUND)
+    for (size_t i = state->flushedFixups; i < state->fixupsCount; i++)
     {
-        argRes.value.argType |= ImmediateNumberArg;
-        argRes.value.immed    = labelCodePostitionResult.value;
-        argRes.error          = EVERYTHING_FINE;
+        const Fixup* fixup = &state->fixups[i];
+        const Label* label = &state->labels.labels[fixup->labelIndex];
 
-        *argStr += readChars;
+        if (!label->isDefined)
+        {
+            state->fixups[pendingCount++] = *fixup;
+            continue;
+        }
 
-        return argRes;
+        ErrorCode patchError = _patchImmediate(state, state->codeArray + (fixup->codePosition - state->codeBase), fixup);
+        if (patchError)
+        {
+            _printLineError(state, patchError, fixup->tokenIndex, NULL);
+            return patchError;
+        }
     }
 
-    if (isSecondRun)
-        return {{}, ERROR_SYNTAX};
+    state->fixupsCount = pendingCount;
 
-    argRes.value.argType = ImmediateNumberArg;
-    argRes.value.immed   = LABEL_NOT_FOUND;
+    return EVERYTHING_FINE;
+}
 
-    return argRes;
+static ErrorCode _resolveFlushedFixups(AssemblerState* state, FILE* binaryFile)
+{
+    if (fflush(binaryFile) != 0)
+        return ERROR_BAD_FILE;
+
+    int binaryFd = fileno(binaryFile);
+
+    for (size_t i = 0; i < state->fixupsCount; i++)
+    {
+        const Fixup* fixup = &state->fixups[i];
+        const Label* label = &state->labels.labels[fixup->labelIndex];
+
+        if (!label->isDefined)
+        {
+            _printLineError(state, ERROR_SYNTAX, fixup->tokenIndex, NULL);
+            return ERROR_SYNTAX;
+        }
+
+        byte    immediate[sizeof(double)] = {};
+        ssize_t immedSize = (ssize_t)ImmediateSize(fixup->width, state->format);
+
+        if (pread(binaryFd, immediate, (size_t)immedSize, (off_t)fixup->codePosition) != immedSize)
+            return ERROR_BAD_FILE;
+
+        ErrorCode patchError = _patchImmediate(state, immediate, fixup);
+        if (patchError)
+        {
+            _printLineError(state, patchError, fixup->tokenIndex, NULL);
+            return patchError;
+        }
+
+        if (pwrite(binaryFd, immediate, (size_t)immedSize, (off_t)fixup->codePosition) != immedSize)
+            return ERROR_BAD_FILE;
+    }
+
+    state->fixupsCount = 0;
+
+    return EVERYTHING_FINE;
 }
 
-static ArgResult _parseImmedLabel(const char** argStr, const Label labelArray[], bool isSecondRun)
+static ErrorCode _patchImmediate(const AssemblerState* state, byte* immediate, const Fixup* fixup)
 {
-    ArgResult immRes = _parseImmed(argStr);
+    const Label* label = &state->labels.labels[fixup->labelIndex];
 
-    if (!immRes.error)
-        return immRes;
-    else
+    return PatchImmediate(immediate, fixup->width, state->format,
+                          label->codePosition / (double)CodeUnitSize(state->format));
+}
+
+static void _writeListingLines(const AssemblerState* state, const Text* code, size_t firstLine, OutputBuffer* listing)
+{
+    for (size_t i = 0; i < state->listingCount; i++)
     {
-        ArgResult labelRes = _parseLabel(argStr, isSecondRun, labelArray);
+        const ListingLine* line   = &state->listing[i];
+        const String* curToken    = &code->tokens[line->tokenIndex - firstLine];
+
+        // columns are padded to the same width as the header
+        char* where = OutputBufferReserve(listing, LISTING_LINE_WIDTH + curToken->length + 1);
+        if (!where)
+            return;
 
-        if (!labelRes.error)
-            return labelRes;
+        if (!line->commandInfo)
+            where = FormatSpaces(where, LISTING_LINE_WIDTH);
         else
-            return {{}, ERROR_SYNTAX};
+        {
+            const byte* codePtr = state->codeArray + (line->codePosition - state->codeBase);
+            Instruction instruction = DecodeInstruction(codePtr, state->codePosition - line->codePosition,
+                                                        state->format).value;
+
+            // aligned code keeps the argument type apart, it is shown the same way as in the other formats
+            byte cmd = (byte)(instruction.command | (instruction.argType << BITS_FOR_COMMAND));
+
+            where = FormatSpaces(where, 13);
+            memcpy(where, " [0x", 4);
+            where = FormatHex(where + 4, line->codePosition, 16);
+            memcpy(where, "] ", 2);
+            where = FormatSpaces(where + 2, 4);
+
+            memcpy(where, "0x", 2);
+            where = FormatHex(where + 2, cmd, 2);
+            *where++ = ' ';
+
+            if (line->commandInfo->hasArg)
+            {
+                uint64_t immed = 0;
+                if (instruction.argType & ImmediateNumberArg)
+                    memcpy(&immed, &instruction.immed, sizeof(immed));
+
+                where = FormatSpaces(where, 4);
+                memcpy(where, "0x", 2);
+                where = FormatHex(where + 2, immed, 16);
+                memcpy(where, " 0x", 3);
+                where = FormatHex(where + 3, instruction.regNum, 2);
+                where = FormatSpaces(where, 11);
+            }
+            else
+                where = FormatSpaces(where, 38);
+        }
+
+        memcpy(where, curToken->text, curToken->length);
+        where += curToken->length;
+        *where++ = '\n';
+
+        OutputBufferCommit(listing, where);
     }
 }
 
-static ErrorCode _insertLabel(Label labelArray[], size_t* freeLabelCell, const String* curToken, const char* labelEnd,
-                              size_t codePosition)
+static void _writeListingLabels(const AssemblerState* state, OutputBuffer* listing)
 {
-    MyAssertSoft(labelArray, ERROR_NULLPTR);
-    MyAssertSoft(freeLabelCell, ERROR_NULLPTR);
-    MyAssertSoft(curToken, ERROR_NULLPTR);
-    MyAssertSoft(labelEnd, ERROR_NULLPTR);
+    OutputBufferPrintf(listing, "\nLabel array:\n");
+    for (size_t i = 0; i < state->labels.size; i++)
+    {
+        OutputBufferPrintf(listing, "[%zu]\n", i);
+        OutputBufferPrintf(listing, "{\n%4scodePosition = %lg\n", "", state->labels.labels[i].codePosition);
+        OutputBufferPrintf(listing, "%4slabel = %.*s\n}\n", "", (int)state->labels.labels[i].name.length,
+                                                              state->labels.labels[i].name.text);
+    }
+}
 
-    if (*freeLabelCell >= MAX_LABELS)
-        return ERROR_TOO_MANY_LABELS;
+static void _printLineError(const AssemblerState* state, ErrorCode error, size_t tokenIndex,
+                            const String* curToken)
+{
+    if (curToken)
+        fprintf(state->diagnostics, CONSOLE_COLOR_FORMAT "%s in line #%zu: \"%.*s\"\n" CONSOLE_COLOR_FORMAT,
+                (int)COLOR_RED, ERROR_CODE_NAMES[error], tokenIndex, (int)curToken->length, curToken->text,
+                (int)COLOR_WHITE);
+    else
+        fprintf(state->diagnostics, CONSOLE_COLOR_FORMAT "%s in line #%zu\n" CONSOLE_COLOR_FORMAT,
+                (int)COLOR_RED, ERROR_CODE_NAMES[error], tokenIndex, (int)COLOR_WHITE);
+}
 
-    const char* labelStart = curToken->text;
+static ArgResult _parseArg(Lexer* lexer, AssemblerState* state)
+{
+    MyAssertSoftResult(lexer, {}, ERROR_NULLPTR);
+    MyAssertSoftResult(state, {}, ERROR_NULLPTR);
 
-    while (isspace(*labelStart) && labelStart < labelEnd) labelStart++;
+    Lexeme lexeme = LexerNext(lexer);
 
-    size_t labelLength = labelEnd - labelStart;
+    bool isRAM = lexeme.type == LEXEME_OPEN_BRACKET;
+    if (isRAM)
+        lexeme = LexerNext(lexer);
 
-    if (labelLength == 0 || labelLength > MAX_LABEL_SIZE)
-        return ERROR_WRONG_LABEL_SIZE;
+    ArgResult argRes = _parseOperand(&lexeme, state, true);
+    RETURN_ERROR_RESULT(argRes, {});
 
-    char* label = (char*)calloc(labelLength + 1, 1);
+    lexeme = LexerNext(lexer);
 
-    strncpy(label, labelStart, labelLength);
-    label[labelLength] = '\0';
+    if (lexeme.type == LEXEME_PLUS)
+    {
+        lexeme = LexerNext(lexer);
 
-    labelArray[*freeLabelCell].label = label;
-    labelArray[*freeLabelCell].codePosition = codePosition;
+        ArgResult addendRes = _parseOperand(&lexeme, state, false);
+        RETURN_ERROR_RESULT(addendRes, {});
 
-    (*freeLabelCell)++;
+        argRes.value.argType  |= addendRes.value.argType;
+        argRes.value.immed    += addendRes.value.immed;
+        argRes.value.hasLabel |= addendRes.value.hasLabel;
 
-    return EVERYTHING_FINE;
+        for (size_t i = 0; i < addendRes.value.unresolvedLabelsCount; i++)
+            argRes.value.unresolvedLabels[argRes.value.unresolvedLabelsCount++] =
+                addendRes.value.unresolvedLabels[i];
+
+        lexeme = LexerNext(lexer);
+    }
+
+    if (isRAM)
+    {
+        if (lexeme.type != LEXEME_CLOSE_BRACKET)
+            return {{}, ERROR_SYNTAX};
+
+        argRes.value.argType |= RAMArg;
+        lexeme = LexerNext(lexer);
+    }
+
+    if (lexeme.type != LEXEME_END)
+        return {{}, ERROR_SYNTAX};
+
+    return argRes;
+}
+
+static ArgResult _parseOperand(const Lexeme* lexeme, AssemblerState* state, bool allowRegister)
+{
+    if (lexeme->type == LEXEME_LABEL)
+        return _parseLabel(lexeme, state);
+
+    ArgResult argRes = {};
+
+    if (lexeme->type == LEXEME_REGISTER && allowRegister)
+    {
+        argRes.value.argType = RegisterArg;
+        argRes.value.regNum  = lexeme->regNum;
+    }
+    else if (lexeme->type == LEXEME_NUMBER)
+    {
+        // added to 0 like the sscanf parser did, so "-0" is stored as 0
+        argRes.value.argType = ImmediateNumberArg;
+        argRes.value.immed  += lexeme->number;
+    }
+    else
+        argRes.error = ERROR_SYNTAX;
+
+    return argRes;
 }
 
-static CodePositionResult _getLabelCodePosition(const Label labelArray[], const char* label)
+static ArgResult _parseLabel(const Lexeme* lexeme, AssemblerState* state)
 {
-    MyAssertSoftResult(labelArray, LABEL_NOT_FOUND, ERROR_NULLPTR);
-    MyAssertSoftResult(label,      LABEL_NOT_FOUND, ERROR_NULLPTR);
+    ArgResult argRes = {};
+
+    // the table keeps a view of the name, the lexeme points to the source
+    LabelIndexResult labelIndexRes = LabelTableInsert(&state->labels, lexeme->text.text, lexeme->text.length);
+
+    RETURN_ERROR_RESULT(labelIndexRes, {});
+
+    const Label* labelPtr = &state->labels.labels[labelIndexRes.value];
 
-    for (size_t i = 0; i < MAX_LABELS; i++)
-        if (labelArray[i].label && strncmp(labelArray[i].label, label, MAX_LABEL_SIZE) == 0)
-            return {labelArray[i].codePosition, EVERYTHING_FINE};
+    argRes.value.argType  = ImmediateNumberArg;
+    argRes.value.hasLabel = true;
 
-    return {LABEL_NOT_FOUND, EVERYTHING_FINE};
+    if (labelPtr->isDefined && !state->deferLabels)
+        argRes.value.immed = labelPtr->codePosition / (double)CodeUnitSize(state->format);
+    else
+        argRes.value.unresolvedLabels[argRes.value.unresolvedLabelsCount++] = labelIndexRes.value;
+
+    return argRes;
 }
 
-static byte _translateCommandToBinFormat(Command command, byte argType)
+static ErrorCode _insertLabel(LabelTable* labels, const String* line, const char* labelEnd,
+                              size_t codePosition)
 {
-    return ((byte)command | (argType << BITS_FOR_COMMAND));
+    MyAssertSoft(labels, ERROR_NULLPTR);
+    MyAssertSoft(line, ERROR_NULLPTR);
+    MyAssertSoft(labelEnd, ERROR_NULLPTR);
+
+    const char* labelStart = line->text;
+
+    while (isspace(*labelStart) && labelStart < labelEnd) labelStart++;
+
+    size_t labelLength = labelEnd - labelStart;
+
+    if (labelLength == 0)
+        return ERROR_WRONG_LABEL_SIZE;
+
+    LabelIndexResult labelIndexRes = LabelTableDefine(labels, labelStart, labelLength, codePosition);
+
+    return labelIndexRes.error;
 }
+
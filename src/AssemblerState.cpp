@@ -0,0 +1,208 @@
+#include <string.h>
+#include "AssemblerState.hpp"
+
+// every thread counts its own, so compilations on different threads don't share a counter
+static thread_local size_t growArrayCount = 0;
+
+ErrorCode GrowArray(void** array, size_t* capacity, size_t size, size_t elementSize)
+{
+    if (size <= *capacity)
+        return EVERYTHING_FINE;
+
+    size_t newCapacity = *capacity ? *capacity : 16;
+    while (newCapacity < size)
+        newCapacity *= 2;
+
+    void* newArray = realloc(*array, newCapacity * elementSize);
+    MyAssertSoft(newArray, ERROR_NO_MEMORY);
+
+    *array    = newArray;
+    *capacity = newCapacity;
+
+    growArrayCount++;
+
+    return EVERYTHING_FINE;
+}
+
+size_t GrowArrayCount()
+{
+    return growArrayCount;
+}
+
+ErrorCode CodeIrReserve(CodeIr* ir, size_t count)
+{
+    MyAssertSoft(ir, ERROR_NULLPTR);
+
+    if (count <= ir->capacity)
+        return EVERYTHING_FINE;
+
+    void** arrays[] = {(void**)&ir->commands, (void**)&ir->argTypes, (void**)&ir->regNums, (void**)&ir->widths,
+                       (void**)&ir->sizes, (void**)&ir->fixupsCounts, (void**)&ir->immeds};
+    size_t sizes[]  = {sizeof(*ir->commands), sizeof(*ir->argTypes), sizeof(*ir->regNums), sizeof(*ir->widths),
+                       sizeof(*ir->sizes), sizeof(*ir->fixupsCounts), sizeof(*ir->immeds)};
+
+    // every array grows from the same capacity, so they all get the same new one
+    size_t capacity = ir->capacity;
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(*arrays); i++)
+    {
+        capacity = ir->capacity;
+        RETURN_ERROR(GrowArray(arrays[i], &capacity, count, sizes[i]));
+    }
+
+    ir->capacity = capacity;
+
+    return EVERYTHING_FINE;
+}
+
+ErrorCode CodeIrAppend(CodeIr* ir, const Instruction* instruction, size_t fixupsCount)
+{
+    MyAssertSoft(ir, ERROR_NULLPTR);
+    MyAssertSoft(instruction, ERROR_NULLPTR);
+
+    if (ir->count == ir->capacity)
+        RETURN_ERROR(CodeIrReserve(ir, ir->count + 1));
+
+    size_t index = ir->count++;
+
+    ir->commands[index]     = instruction->command;
+    ir->argTypes[index]     = instruction->argType;
+    ir->regNums[index]      = instruction->regNum;
+    ir->widths[index]       = (byte)instruction->width;
+    ir->sizes[index]        = (byte)instruction->size;
+    ir->fixupsCounts[index] = (byte)fixupsCount;
+    ir->immeds[index]       = instruction->immed;
+
+    return EVERYTHING_FINE;
+}
+
+ErrorCode BuildCodeIr(AssemblerState* state)
+{
+    MyAssertSoft(state, ERROR_NULLPTR);
+
+    state->ir.count = 0;
+
+    size_t fixup = 0;
+
+    for (size_t position = 0; position < state->codePosition; )
+    {
+        InstructionResult instructionRes = DecodeInstruction(state->codeArray + position,
+                                                             state->codePosition - position, state->format);
+        if (instructionRes.error)
+            return ERROR_BAD_SIZE;
+
+        size_t next = position + instructionRes.value.size;
+
+        // fixups are in the order of the code
+        size_t firstFixup = fixup;
+        while (fixup < state->fixupsCount && state->fixups[fixup].codePosition < next)
+            fixup++;
+
+        RETURN_ERROR(CodeIrAppend(&state->ir, &instructionRes.value, fixup - firstFixup));
+
+        position = next;
+    }
+
+    return EVERYTHING_FINE;
+}
+
+void DestroyAssemblerState(AssemblerState* state)
+{
+    MyAssertHard(state, ERROR_NULLPTR, );
+
+    free(state->codeArray);
+    free(state->fixups);
+    free(state->listing);
+
+    free(state->ir.commands);
+    free(state->ir.argTypes);
+    free(state->ir.regNums);
+    free(state->ir.widths);
+    free(state->ir.sizes);
+    free(state->ir.fixupsCounts);
+    free(state->ir.immeds);
+    LabelTableDestroy(&state->labels);
+}
+
+ErrorCode MergeAssemblerState(AssemblerState* state, const AssemblerState* part, size_t firstLine)
+{
+    MyAssertSoft(state, ERROR_NULLPTR);
+    MyAssertSoft(part,  ERROR_NULLPTR);
+
+    size_t base = state->codePosition;
+
+    RETURN_ERROR(GrowArray((void**)&state->codeArray, &state->codeCapacity,
+                            base + part->codePosition, sizeof(*state->codeArray)));
+    RETURN_ERROR(GrowArray((void**)&state->fixups, &state->fixupsCapacity,
+                            state->fixupsCount + part->fixupsCount, sizeof(*state->fixups)));
+    if (state->writeListing)
+        RETURN_ERROR(GrowArray((void**)&state->listing, &state->listingCapacity,
+                                state->listingCount + part->listingCount, sizeof(*state->listing)));
+    if (state->collectIr)
+        RETURN_ERROR(CodeIrReserve(&state->ir, state->ir.count + part->ir.count));
+
+    if (part->codePosition)
+        memcpy(state->codeArray + base, part->codeArray, part->codePosition);
+    state->codePosition += part->codePosition;
+
+    state->commandsCount  += part->commandsCount;
+    state->labels.lookups += part->labels.lookups;
+    state->labels.probes  += part->labels.probes;
+
+    size_t* globalIndexes = (size_t*)calloc(part->labels.size + 1, sizeof(*globalIndexes));
+    MyAssertSoft(globalIndexes, ERROR_NO_MEMORY);
+
+    // parts are merged in order, so labels keep the order of their first appearance and first definition wins
+    for (size_t i = 0; i < part->labels.size; i++)
+    {
+        const Label* label = &part->labels.labels[i];
+
+        LabelIndexResult indexRes = label->isDefined ?
+            LabelTableDefine(&state->labels, label->name.text, label->name.length, (double)base + label->codePosition) :
+            LabelTableInsert(&state->labels, label->name.text, label->name.length);
+
+        MyAssertSoft(!indexRes.error, indexRes.error, free(globalIndexes));
+
+        globalIndexes[i] = indexRes.value;
+    }
+
+    for (size_t i = 0; i < part->fixupsCount; i++)
+    {
+        Fixup fixup = part->fixups[i];
+
+        fixup.codePosition += base;
+        fixup.tokenIndex   += firstLine;
+        fixup.labelIndex    = globalIndexes[fixup.labelIndex];
+
+        state->fixups[state->fixupsCount++] = fixup;
+    }
+
+    for (size_t i = 0; i < part->listingCount && state->writeListing; i++)
+    {
+        ListingLine line = part->listing[i];
+        line.codePosition += base;
+        line.tokenIndex   += firstLine;
+
+        state->listing[state->listingCount++] = line;
+    }
+
+    // nothing in the IR depends on where the part is
+    if (state->collectIr && part->ir.count)
+    {
+        const CodeIr* ir    = &part->ir;
+        size_t        count = state->ir.count;
+
+        memcpy(state->ir.commands     + count, ir->commands,     ir->count * sizeof(*ir->commands));
+        memcpy(state->ir.argTypes     + count, ir->argTypes,     ir->count * sizeof(*ir->argTypes));
+        memcpy(state->ir.regNums      + count, ir->regNums,      ir->count * sizeof(*ir->regNums));
+        memcpy(state->ir.widths       + count, ir->widths,       ir->count * sizeof(*ir->widths));
+        memcpy(state->ir.sizes        + count, ir->sizes,        ir->count * sizeof(*ir->sizes));
+        memcpy(state->ir.fixupsCounts + count, ir->fixupsCounts, ir->count * sizeof(*ir->fixupsCounts));
+        memcpy(state->ir.immeds       + count, ir->immeds,       ir->count * sizeof(*ir->immeds));
+
+        state->ir.count += ir->count;
+    }
+
+    free(globalIndexes);
+
+    return EVERYTHING_FINE;
+}
@@ -0,0 +1,234 @@
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "AssemblyCache.hpp"
+#include "ObjectFile.hpp"
+
+static const uint32_t CACHE_MAGIC         = 0x48434744; // "DGCH"
+static const uint32_t CACHE_VERSION       = 3;
+static const size_t   CACHE_BUFFER_SIZE   = 1 << 20;
+
+/** @struct CacheHeader
+ * @brief Start of a cache file, entries of a hash and a block size followed by the block come after it.
+ */
+struct CacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t entriesCount;
+};
+
+struct CacheEntryHeader
+{
+    uint64_t hash;
+    uint64_t size;
+};
+
+static ErrorCode _indexCache(AssemblyCache* cache, size_t entriesCount);
+
+ErrorCode AssemblyCacheOpen(AssemblyCache* cache, const char* path, CodeFormat format)
+{
+    MyAssertSoft(cache, ERROR_NULLPTR);
+    MyAssertSoft(path,  ERROR_NULLPTR);
+
+    *cache = {};
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return EVERYTHING_FINE;
+
+    struct stat fileStat = {};
+    if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(CacheHeader))
+    {
+        close(fd);
+        return EVERYTHING_FINE;
+    }
+
+    void* mapping = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+        return EVERYTHING_FINE;
+
+    cache->data = (const byte*)mapping;
+    cache->size = (size_t)fileStat.st_size;
+
+    CacheHeader header = {};
+    memcpy(&header, cache->data, sizeof(header));
+
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.format != (uint32_t)format ||
+        header.entriesCount > cache->size / sizeof(CacheEntryHeader))
+    {
+        AssemblyCacheClose(cache);
+        return EVERYTHING_FINE;
+    }
+
+    ErrorCode error = _indexCache(cache, header.entriesCount);
+
+    // a broken cache is as good as none, only running out of memory is an error
+    if (error)
+        AssemblyCacheClose(cache);
+
+    return error == ERROR_NO_MEMORY ? error : EVERYTHING_FINE;
+}
+
+const byte* AssemblyCacheFind(const AssemblyCache* cache, uint64_t hash, size_t* size)
+{
+    MyAssertHard(cache, ERROR_NULLPTR);
+    MyAssertHard(size,  ERROR_NULLPTR);
+
+    if (cache->slotsCount == 0)
+        return NULL;
+
+    size_t mask = cache->slotsCount - 1;
+    for (size_t slot = hash & mask; cache->offsets[slot]; slot = (slot + 1) & mask)
+    {
+        if (cache->hashes[slot] == hash)
+        {
+            *size = cache->sizes[slot];
+            return cache->data + cache->offsets[slot];
+        }
+    }
+
+    return NULL;
+}
+
+void AssemblyCacheClose(AssemblyCache* cache)
+{
+    MyAssertHard(cache, ERROR_NULLPTR, );
+
+    if (cache->data)
+        munmap((void*)cache->data, cache->size);
+
+    free(cache->hashes);
+    free(cache->offsets);
+    free(cache->sizes);
+
+    *cache = {};
+}
+
+ErrorCode AssemblyCacheWriterOpen(AssemblyCacheWriter* writer, const char* path, CodeFormat format)
+{
+    MyAssertSoft(writer, ERROR_NULLPTR);
+    MyAssertSoft(path,   ERROR_NULLPTR);
+
+    *writer = {};
+    writer->path = path;
+
+    writer->tempPath = (char*)calloc(strlen(path) + sizeof(".tmp"), sizeof(*writer->tempPath));
+    MyAssertSoft(writer->tempPath, ERROR_NO_MEMORY);
+
+    strcpy(writer->tempPath, path);
+    strcat(writer->tempPath, ".tmp");
+
+    writer->file = fopen(writer->tempPath, "wb");
+    MyAssertSoft(writer->file, ERROR_BAD_FILE, free(writer->tempPath));
+
+    ErrorCode error = OutputBufferInit(&writer->output, writer->file, CACHE_BUFFER_SIZE);
+    if (error)
+    {
+        fclose(writer->file);
+        free(writer->tempPath);
+        return error;
+    }
+
+    // the number of entries is patched in when the cache is closed
+    CacheHeader header = {CACHE_MAGIC, CACHE_VERSION, (uint32_t)format, 0};
+    OutputBufferWrite(&writer->output, (const char*)&header, sizeof(header));
+
+    return writer->output.error;
+}
+
+ErrorCode AssemblyCacheWriterAdd(AssemblyCacheWriter* writer, uint64_t hash, const AssemblerState* block)
+{
+    MyAssertSoft(writer, ERROR_NULLPTR);
+    MyAssertSoft(block,  ERROR_NULLPTR);
+
+    CacheEntryHeader entryHeader = {hash, AssembledBlockSize(block)};
+    OutputBufferWrite(&writer->output, (const char*)&entryHeader, sizeof(entryHeader));
+
+    writer->entriesCount++;
+
+    return WriteAssembledBlock(&writer->output, block);
+}
+
+ErrorCode AssemblyCacheWriterClose(AssemblyCacheWriter* writer, bool commit)
+{
+    MyAssertSoft(writer, ERROR_NULLPTR);
+
+    ErrorCode error = OutputBufferDestroy(&writer->output);
+
+    if (!error && commit)
+    {
+        uint32_t entriesCount = (uint32_t)writer->entriesCount;
+
+        if (fseek(writer->file, offsetof(CacheHeader, entriesCount), SEEK_SET) != 0 ||
+            fwrite(&entriesCount, sizeof(entriesCount), 1, writer->file) != 1)
+            error = ERROR_BAD_FILE;
+    }
+
+    if (fclose(writer->file) != 0 && !error)
+        error = ERROR_BAD_FILE;
+
+    if (!error && commit && rename(writer->tempPath, writer->path) != 0)
+        error = ERROR_BAD_FILE;
+
+    if (error || !commit)
+        remove(writer->tempPath);
+
+    free(writer->tempPath);
+    *writer = {};
+
+    return error;
+}
+
+static ErrorCode _indexCache(AssemblyCache* cache, size_t entriesCount)
+{
+    size_t slotsCount = 16;
+    while (slotsCount < 2 * entriesCount)
+        slotsCount *= 2;
+
+    cache->hashes  = (uint64_t*)calloc(slotsCount, sizeof(*cache->hashes));
+    cache->offsets = (size_t*)  calloc(slotsCount, sizeof(*cache->offsets));
+    cache->sizes   = (size_t*)  calloc(slotsCount, sizeof(*cache->sizes));
+    MyAssertSoft(cache->hashes && cache->offsets && cache->sizes, ERROR_NO_MEMORY);
+
+    cache->slotsCount = slotsCount;
+
+    size_t mask     = slotsCount - 1;
+    size_t position = sizeof(CacheHeader);
+
+    for (size_t i = 0; i < entriesCount; i++)
+    {
+        CacheEntryHeader entryHeader = {};
+
+        if (cache->size - position < sizeof(entryHeader))
+            return ERROR_BAD_SIZE;
+
+        memcpy(&entryHeader, cache->data + position, sizeof(entryHeader));
+        position += sizeof(entryHeader);
+
+        if (cache->size - position < entryHeader.size)
+            return ERROR_BAD_SIZE;
+
+        size_t slot = entryHeader.hash & mask;
+        while (cache->offsets[slot] && cache->hashes[slot] != entryHeader.hash)
+            slot = (slot + 1) & mask;
+
+        // the same block may be met several times, the first one is kept
+        if (!cache->offsets[slot])
+        {
+            cache->hashes [slot] = entryHeader.hash;
+            cache->offsets[slot] = position;
+            cache->sizes  [slot] = entryHeader.size;
+        }
+
+        position += entryHeader.size;
+    }
+
+    return EVERYTHING_FINE;
+}
@@ -0,0 +1,260 @@
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "Batch.hpp"
+#include "OneginFunctions.hpp"
+
+/** @struct BatchFile
+ * @brief File of a batch and what compiling it gave.
+ *
+ * @var BatchFile::codeFilePath - the source.
+ * @var BatchFile::byteCodeFilePath - where to write the byte code.
+ * @var BatchFile::listingFilePath - where to write the listing or NULL.
+ * @var BatchFile::diagnostics - errors printed while compiling.
+ * @var BatchFile::diagnosticsSize - length of diagnostics.
+ * @var BatchFile::error - how compiling went.
+ */
+struct BatchFile
+{
+    char* codeFilePath;
+    char* byteCodeFilePath;
+    char* listingFilePath;
+
+    char*  diagnostics;
+    size_t diagnosticsSize;
+
+    ErrorCode error;
+};
+
+/** @struct BatchPool
+ * @brief What the threads of the pool share.
+ *
+ * @var BatchPool::files - files of the batch.
+ * @var BatchPool::filesCount - number of files.
+ * @var BatchPool::nextFile - the first file no thread took yet.
+ * @var BatchPool::options - settings of every file.
+ */
+struct BatchPool
+{
+    BatchFile* files;
+    size_t     filesCount;
+    size_t     nextFile;
+
+    const CompileOptions* options;
+};
+
+static ErrorCode _readManifest(BatchPool* pool, const char* manifestPath, bool writeListing);
+
+static ErrorCode _addBatchFile(BatchPool* pool, size_t* capacity, const String* line, bool writeListing);
+
+static void* _batchWorker(void* pool);
+
+static void _compileBatchFile(BatchFile* file, const CompileOptions* options);
+
+static char* _copyPath(const char* path, size_t length);
+
+static void _destroyPool(BatchPool* pool);
+
+char* CreateListingPath(const char* byteCodeFilePath)
+{
+    MyAssertHard(byteCodeFilePath, ERROR_NULLPTR);
+
+    char* listingFilePath = (char*)calloc(strlen(byteCodeFilePath) + sizeof("_listing.txt"), 1);
+    if (!listingFilePath)
+        return NULL;
+
+    strcpy(listingFilePath, byteCodeFilePath);
+    strcat(listingFilePath, "_listing.txt");
+
+    return listingFilePath;
+}
+
+ErrorCode CompileBatch(const char* manifestPath, const CompileOptions* options, bool writeListing)
+{
+    MyAssertSoft(manifestPath, ERROR_NULLPTR);
+    MyAssertSoft(options, ERROR_NULLPTR);
+
+    // files are the unit of work, so every file is compiled on a single thread
+    CompileOptions fileOptions = *options;
+    fileOptions.jobs  = 1;
+    // statistics are of a single compilation, files of a batch would share them
+    fileOptions.stats = NULL;
+
+    BatchPool pool = {};
+    pool.options   = &fileOptions;
+
+    ErrorCode error = _readManifest(&pool, manifestPath, writeListing);
+
+    size_t threadsCount = options->jobs ? options->jobs : (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadsCount > pool.filesCount)
+        threadsCount = pool.filesCount;
+
+    pthread_t* threads = NULL;
+    if (!error && threadsCount)
+    {
+        threads = (pthread_t*)calloc(threadsCount, sizeof(*threads));
+        if (!threads)
+            error = ERROR_NO_MEMORY;
+    }
+
+    size_t startedCount = 0;
+    for (; !error && startedCount < threadsCount; startedCount++)
+        if (pthread_create(&threads[startedCount], NULL, _batchWorker, &pool) != 0)
+            break;
+
+    // the pool works with as many threads as started, the main thread helps if none did
+    if (!error && startedCount == 0)
+        _batchWorker(&pool);
+
+    for (size_t i = 0; i < startedCount; i++)
+        pthread_join(threads[i], NULL);
+
+    for (size_t i = 0; i < pool.filesCount && !error; i++)
+    {
+        const BatchFile* file = &pool.files[i];
+
+        if (file->diagnosticsSize)
+            fwrite(file->diagnostics, sizeof(*file->diagnostics), file->diagnosticsSize, stdout);
+
+        if (file->error)
+            printf("COMPILE ERROR %s in %s!!!\n", ERROR_CODE_NAMES[file->error], file->codeFilePath);
+    }
+
+    for (size_t i = 0; i < pool.filesCount && !error; i++)
+        error = pool.files[i].error;
+
+    free(threads);
+    _destroyPool(&pool);
+
+    return error;
+}
+
+static ErrorCode _readManifest(BatchPool* pool, const char* manifestPath, bool writeListing)
+{
+    Text manifest = CreateTextMapped(manifestPath, '\n');
+    MyAssertSoft(manifest.rawText, ERROR_BAD_FILE);
+
+    size_t capacity = 0;
+    ErrorCode error = EVERYTHING_FINE;
+
+    for (size_t i = 0; i < manifest.numberOfTokens && !error; i++)
+        if (!StringIsEmptyChars(&manifest.tokens[i]))
+            error = _addBatchFile(pool, &capacity, &manifest.tokens[i], writeListing);
+
+    DestroyText(&manifest);
+
+    return error;
+}
+
+static ErrorCode _addBatchFile(BatchPool* pool, size_t* capacity, const String* line, bool writeListing)
+{
+    const char* lineEnd = line->text + line->length;
+    const char* paths[2]       = {};
+    size_t      pathLengths[2] = {};
+
+    const char* linePtr = line->text;
+    for (size_t i = 0; i < 2; i++)
+    {
+        while (linePtr < lineEnd && isspace(*linePtr))
+            linePtr++;
+
+        paths[i] = linePtr;
+        while (linePtr < lineEnd && !isspace(*linePtr))
+            linePtr++;
+
+        pathLengths[i] = (size_t)(linePtr - paths[i]);
+    }
+
+    String rest = {linePtr, (size_t)(lineEnd - linePtr)};
+
+    if (pathLengths[1] == 0 || !StringIsEmptyChars(&rest))
+    {
+        printf("Bad manifest line: \"%.*s\", expected \"input output\"\n", (int)line->length, line->text);
+        return ERROR_SYNTAX;
+    }
+
+    if (pool->filesCount == *capacity)
+    {
+        size_t newCapacity = *capacity ? *capacity * 2 : 16;
+        BatchFile* newFiles = (BatchFile*)realloc(pool->files, newCapacity * sizeof(*newFiles));
+        MyAssertSoft(newFiles, ERROR_NO_MEMORY);
+
+        pool->files = newFiles;
+        *capacity   = newCapacity;
+    }
+
+    BatchFile* file = &pool->files[pool->filesCount++];
+    *file = {};
+
+    file->codeFilePath     = _copyPath(paths[0], pathLengths[0]);
+    file->byteCodeFilePath = _copyPath(paths[1], pathLengths[1]);
+    MyAssertSoft(file->codeFilePath && file->byteCodeFilePath, ERROR_NO_MEMORY);
+
+    if (writeListing)
+    {
+        file->listingFilePath = CreateListingPath(file->byteCodeFilePath);
+        MyAssertSoft(file->listingFilePath, ERROR_NO_MEMORY);
+    }
+
+    return EVERYTHING_FINE;
+}
+
+static void* _batchWorker(void* pool)
+{
+    BatchPool* batchPool = (BatchPool*)pool;
+
+    while (true)
+    {
+        size_t fileIndex = __atomic_fetch_add(&batchPool->nextFile, 1, __ATOMIC_RELAXED);
+        if (fileIndex >= batchPool->filesCount)
+            break;
+
+        _compileBatchFile(&batchPool->files[fileIndex], batchPool->options);
+    }
+
+    return NULL;
+}
+
+static void _compileBatchFile(BatchFile* file, const CompileOptions* options)
+{
+    // every file reports into its own memory stream, so threads don't mix their errors
+    FILE* diagnostics = open_memstream(&file->diagnostics, &file->diagnosticsSize);
+    if (!diagnostics)
+    {
+        file->error = ERROR_NO_MEMORY;
+        return;
+    }
+
+    CompileOptions fileOptions = *options;
+    fileOptions.diagnostics    = diagnostics;
+
+    file->error = Compile(file->codeFilePath, file->byteCodeFilePath, file->listingFilePath, &fileOptions);
+
+    fclose(diagnostics);
+}
+
+static char* _copyPath(const char* path, size_t length)
+{
+    char* copy = (char*)calloc(length + 1, sizeof(*copy));
+    if (!copy)
+        return NULL;
+
+    memcpy(copy, path, length);
+
+    return copy;
+}
+
+static void _destroyPool(BatchPool* pool)
+{
+    for (size_t i = 0; i < pool->filesCount; i++)
+    {
+        free(pool->files[i].codeFilePath);
+        free(pool->files[i].byteCodeFilePath);
+        free(pool->files[i].listingFilePath);
+        free(pool->files[i].diagnostics);
+    }
+
+    free(pool->files);
+    *pool = {};
+}
@@ -0,0 +1,288 @@
+#include <string.h>
+#include <math.h>
+#include "Bytecode.hpp"
+
+static const size_t IMMEDIATE_SIZES[] =
+{
+    sizeof(int8_t), sizeof(int16_t), sizeof(int32_t), sizeof(float), sizeof(double),
+};
+
+static bool _fitsInteger(double immed, double min, double max);
+
+static size_t _encodeAligned(byte* code, const Instruction* instruction, size_t* immedOffset);
+
+static InstructionResult _decodeAligned(const byte* code, size_t codeSize);
+
+ImmediateWidth ChooseImmediateWidth(double immed, bool hasLabel)
+{
+    if (hasLabel)
+    {
+        bool fits = INT32_MIN <= immed && immed <= INT32_MAX && immed == trunc(immed);
+        return fits ? IMMEDIATE_INT32 : IMMEDIATE_DOUBLE;
+    }
+
+    if (_fitsInteger(immed, INT8_MIN,  INT8_MAX))
+        return IMMEDIATE_INT8;
+    if (_fitsInteger(immed, INT16_MIN, INT16_MAX))
+        return IMMEDIATE_INT16;
+    if (_fitsInteger(immed, INT32_MIN, INT32_MAX))
+        return IMMEDIATE_INT32;
+
+    // NaN fails the comparison and stays a double, so its payload is kept
+    if ((double)(float)immed == immed)
+        return IMMEDIATE_FLOAT32;
+
+    return IMMEDIATE_DOUBLE;
+}
+
+size_t ImmediateSize(ImmediateWidth width, CodeFormat format)
+{
+    if (format != FORMAT_COMPACT)
+        return sizeof(double);
+
+    return IMMEDIATE_SIZES[width];
+}
+
+size_t CodeUnitSize(CodeFormat format)
+{
+    return format == FORMAT_ALIGNED ? ALIGNED_INSTRUCTION_SIZE : 1;
+}
+
+size_t EncodeInstruction(byte* code, const Instruction* instruction, CodeFormat format, size_t* immedOffset)
+{
+    MyAssertHard(code, ERROR_NULLPTR);
+    MyAssertHard(instruction, ERROR_NULLPTR);
+
+    if (format == FORMAT_ALIGNED)
+        return _encodeAligned(code, instruction, immedOffset);
+
+    byte* codePtr = code;
+
+    *codePtr++ = (byte)(instruction->command | (instruction->argType << BITS_FOR_COMMAND));
+
+    if (instruction->argType & ImmediateNumberArg)
+    {
+        ImmediateWidth width = format == FORMAT_PLAIN ? IMMEDIATE_DOUBLE : instruction->width;
+
+        if (format == FORMAT_COMPACT)
+            *codePtr++ = (byte)((width << WIDTH_SHIFT) | (instruction->regNum & REG_NUM_MASK));
+
+        if (immedOffset)
+            *immedOffset = (size_t)(codePtr - code);
+
+        double immed = instruction->immed;
+        switch (width)
+        {
+            case IMMEDIATE_INT8:
+            {
+                int8_t value = (int8_t)immed;
+                memcpy(codePtr, &value, sizeof(value));
+                break;
+            }
+            case IMMEDIATE_INT16:
+            {
+                int16_t value = (int16_t)immed;
+                memcpy(codePtr, &value, sizeof(value));
+                break;
+            }
+            case IMMEDIATE_INT32:
+            {
+                int32_t value = (int32_t)immed;
+                memcpy(codePtr, &value, sizeof(value));
+                break;
+            }
+            case IMMEDIATE_FLOAT32:
+            {
+                float value = (float)immed;
+                memcpy(codePtr, &value, sizeof(value));
+                break;
+            }
+            case IMMEDIATE_DOUBLE:
+            default:
+                memcpy(codePtr, &immed, sizeof(immed));
+                break;
+        }
+        codePtr += ImmediateSize(width, format);
+
+        if (format == FORMAT_PLAIN && (instruction->argType & RegisterArg))
+            *codePtr++ = instruction->regNum;
+    }
+    else if (instruction->argType & RegisterArg)
+        *codePtr++ = instruction->regNum;
+
+    return (size_t)(codePtr - code);
+}
+
+InstructionResult DecodeInstruction(const byte* code, size_t codeSize, CodeFormat format)
+{
+    MyAssertSoftResult(code, {}, ERROR_NULLPTR);
+
+    if (codeSize == 0)
+        return {{}, ERROR_INDEX_OUT_OF_BOUNDS};
+
+    if (format == FORMAT_ALIGNED)
+        return _decodeAligned(code, codeSize);
+
+    Instruction instruction = {};
+    instruction.command = code[0] & COMMAND_MASK;
+    instruction.argType = (byte)(code[0] >> BITS_FOR_COMMAND);
+    instruction.width   = IMMEDIATE_DOUBLE;
+
+    size_t position = 1;
+
+    if (instruction.argType & ImmediateNumberArg)
+    {
+        if (format == FORMAT_COMPACT)
+        {
+            if (position >= codeSize)
+                return {{}, ERROR_INDEX_OUT_OF_BOUNDS};
+
+            byte descriptor = code[position++];
+            if ((descriptor >> WIDTH_SHIFT) > IMMEDIATE_DOUBLE)
+                return {{}, ERROR_BAD_VALUE};
+
+            instruction.width  = (ImmediateWidth)(descriptor >> WIDTH_SHIFT);
+            instruction.regNum = descriptor & REG_NUM_MASK;
+        }
+
+        size_t immedSize = ImmediateSize(instruction.width, format);
+        if (position + immedSize > codeSize)
+            return {{}, ERROR_INDEX_OUT_OF_BOUNDS};
+
+        instruction.immed = ReadImmediate(code + position, instruction.width, format);
+        position += immedSize;
+
+        if (format == FORMAT_PLAIN && (instruction.argType & RegisterArg))
+        {
+            if (position >= codeSize)
+                return {{}, ERROR_INDEX_OUT_OF_BOUNDS};
+
+            instruction.regNum = code[position++];
+        }
+    }
+    else if (instruction.argType & RegisterArg)
+    {
+        if (position >= codeSize)
+            return {{}, ERROR_INDEX_OUT_OF_BOUNDS};
+
+        instruction.regNum = code[position++];
+    }
+
+    instruction.size = position;
+
+    return {instruction, EVERYTHING_FINE};
+}
+
+double ReadImmediate(const byte* immediate, ImmediateWidth width, CodeFormat format)
+{
+    MyAssertHard(immediate, ERROR_NULLPTR);
+
+    if (format != FORMAT_COMPACT)
+        width = IMMEDIATE_DOUBLE;
+
+    switch (width)
+    {
+        case IMMEDIATE_INT8:
+        {
+            int8_t value = 0;
+            memcpy(&value, immediate, sizeof(value));
+            return value;
+        }
+        case IMMEDIATE_INT16:
+        {
+            int16_t value = 0;
+            memcpy(&value, immediate, sizeof(value));
+            return value;
+        }
+        case IMMEDIATE_INT32:
+        {
+            int32_t value = 0;
+            memcpy(&value, immediate, sizeof(value));
+            return value;
+        }
+        case IMMEDIATE_FLOAT32:
+        {
+            float value = 0;
+            memcpy(&value, immediate, sizeof(value));
+            return value;
+        }
+        case IMMEDIATE_DOUBLE:
+        default:
+        {
+            double value = 0;
+            memcpy(&value, immediate, sizeof(value));
+            return value;
+        }
+    }
+}
+
+ErrorCode PatchImmediate(byte* immediate, ImmediateWidth width, CodeFormat format, double delta)
+{
+    MyAssertSoft(immediate, ERROR_NULLPTR);
+
+    if (format != FORMAT_COMPACT)
+        width = IMMEDIATE_DOUBLE;
+
+    // only label immediates are patched and they are int32 or double
+    MyAssertSoft(width == IMMEDIATE_INT32 || width == IMMEDIATE_DOUBLE, ERROR_BAD_VALUE);
+
+    double immed = ReadImmediate(immediate, width, format) + delta;
+
+    if (width == IMMEDIATE_DOUBLE)
+    {
+        memcpy(immediate, &immed, sizeof(immed));
+        return EVERYTHING_FINE;
+    }
+
+    if (!_fitsInteger(immed, INT32_MIN, INT32_MAX))
+        return ERROR_BAD_VALUE;
+
+    int32_t value = (int32_t)immed;
+    memcpy(immediate, &value, sizeof(value));
+
+    return EVERYTHING_FINE;
+}
+
+static bool _fitsInteger(double immed, double min, double max)
+{
+    // -0.0 equals 0 but would lose its sign as an integer
+    return min <= immed && immed <= max && immed == trunc(immed) && !(immed == 0 && signbit(immed));
+}
+
+static size_t _encodeAligned(byte* code, const Instruction* instruction, size_t* immedOffset)
+{
+    memset(code, 0, ALIGNED_INSTRUCTION_SIZE);
+
+    code[0] = instruction->command;
+    code[1] = instruction->argType;
+    code[2] = instruction->regNum;
+
+    if (instruction->argType & ImmediateNumberArg)
+        memcpy(code + ALIGNED_IMMEDIATE_OFFSET, &instruction->immed, sizeof(instruction->immed));
+
+    if (immedOffset)
+        *immedOffset = ALIGNED_IMMEDIATE_OFFSET;
+
+    return ALIGNED_INSTRUCTION_SIZE;
+}
+
+static InstructionResult _decodeAligned(const byte* code, size_t codeSize)
+{
+    if (codeSize < ALIGNED_INSTRUCTION_SIZE)
+        return {{}, ERROR_INDEX_OUT_OF_BOUNDS};
+
+    if (code[0] > COMMAND_MASK || code[1] > (ImmediateNumberArg | RegisterArg | RAMArg))
+        return {{}, ERROR_BAD_VALUE};
+
+    Instruction instruction = {};
+    instruction.command = code[0];
+    instruction.argType = code[1];
+    instruction.regNum  = instruction.argType & RegisterArg ? code[2] : 0;
+    instruction.width   = IMMEDIATE_DOUBLE;
+    instruction.size    = ALIGNED_INSTRUCTION_SIZE;
+
+    if (instruction.argType & ImmediateNumberArg)
+        memcpy(&instruction.immed, code + ALIGNED_IMMEDIATE_OFFSET, sizeof(instruction.immed));
+
+    return {instruction, EVERYTHING_FINE};
+}
@@ -0,0 +1,51 @@
+#include <time.h>
+#include "CompileStats.hpp"
+
+double CompileStatsStart(const CompileStats* stats)
+{
+    if (!stats)
+        return 0;
+
+    timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+void CompileStatsStop(CompileStats* stats, CompilePhase phase, double start)
+{
+    if (!stats)
+        return;
+
+    stats->phaseTimes[phase] += CompileStatsStart(stats) - start;
+}
+
+ErrorCode WriteCompileStatsJson(FILE* file, const CompileStats* stats)
+{
+    MyAssertSoft(file, ERROR_NULLPTR);
+    MyAssertSoft(stats, ERROR_NULLPTR);
+
+    fprintf(file, "{\n"
+                  "    \"seconds\": {\n"
+                  "        \"total\": %.9f", stats->totalTime);
+
+    for (size_t i = 0; i < PHASES_COUNT; i++)
+        fprintf(file, ",\n        \"%s\": %.9f", COMPILE_PHASE_NAMES[i], stats->phaseTimes[i]);
+
+    fprintf(file, "\n"
+                  "    },\n"
+                  "    \"counters\": {\n"
+                  "        \"lines\": %zu,\n"
+                  "        \"instructions\": %zu,\n"
+                  "        \"labels\": %zu,\n"
+                  "        \"labelLookups\": %zu,\n"
+                  "        \"labelProbes\": %zu,\n"
+                  "        \"bytesEmitted\": %zu,\n"
+                  "        \"allocations\": %zu\n"
+                  "    }\n"
+                  "}\n",
+                  stats->lines, stats->instructions, stats->labels, stats->labelLookups, stats->labelProbes,
+                  stats->bytesEmitted, stats->allocations);
+
+    return ferror(file) ? ERROR_BAD_FILE : EVERYTHING_FINE;
+}
@@ -0,0 +1,186 @@
+#include <string.h>
+#include "Executable.hpp"
+
+static const uint64_t EXECUTABLE_CHECKSUM_SEED = 0x44474558;
+static const size_t   SECTION_ALIGNMENT        = sizeof(uint64_t);
+
+static const size_t SYMBOL_RECORD_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+
+static const byte PADDING[EXECUTABLE_PAGE_SIZE] = {};
+
+static byte* _createSymbolSection(const LabelTable* symbols, CodeFormat format, size_t* size);
+
+static ErrorCode _writePadded(FILE* file, size_t* filePosition, const byte* data, size_t size, size_t offset);
+
+static size_t _alignUp(size_t value, size_t alignment);
+
+static uint64_t _headerChecksum(const ExecutableHeader* header);
+
+ErrorCode WriteExecutable(FILE* file, CodeFormat format, const byte* code, size_t codeSize, const LabelTable* symbols)
+{
+    MyAssertSoft(file, ERROR_NULLPTR);
+    MyAssertSoft(code || codeSize == 0, ERROR_NULLPTR);
+    MyAssertSoft(symbols, ERROR_NULLPTR);
+
+    size_t symbolsSize = 0;
+    byte*  symbolsData = _createSymbolSection(symbols, format, &symbolsSize);
+    MyAssertSoft(symbolsData, ERROR_NO_MEMORY);
+
+    // the data section is reserved, nothing is put into the RAM before the program starts yet
+    const byte* sectionData[SECTIONS_COUNT]  = {code, NULL, symbolsData};
+    size_t      sectionSizes[SECTIONS_COUNT] = {codeSize, 0, symbolsSize};
+
+    ExecutableHeader header  = {};
+    header.magic             = EXECUTABLE_MAGIC;
+    header.version           = EXECUTABLE_VERSION;
+    header.commandSetVersion = COMMAND_SET_VERSION;
+    header.format            = (uint32_t)format;
+    header.entryPoint        = 0;
+
+    // the code takes whole pages, so it can be mapped apart from the header
+    size_t offset = _alignUp(sizeof(header), EXECUTABLE_PAGE_SIZE);
+
+    for (size_t i = 0; i < SECTIONS_COUNT; i++)
+    {
+        header.sections[i].offset   = offset;
+        header.sections[i].size     = sectionSizes[i];
+        header.sections[i].checksum = CalculateHash64(sectionData[i], sectionSizes[i], EXECUTABLE_CHECKSUM_SEED);
+
+        offset = _alignUp(offset + sectionSizes[i], SECTION_ALIGNMENT);
+    }
+
+    header.checksum = _headerChecksum(&header);
+
+    size_t    filePosition = 0;
+    ErrorCode error        = _writePadded(file, &filePosition, (const byte*)&header, sizeof(header), 0);
+
+    for (size_t i = 0; i < SECTIONS_COUNT && !error; i++)
+        error = _writePadded(file, &filePosition, sectionData[i], sectionSizes[i], header.sections[i].offset);
+
+    free(symbolsData);
+
+    return error;
+}
+
+bool IsExecutable(const byte* data, size_t size)
+{
+    MyAssertHard(data || size == 0, ERROR_NULLPTR);
+
+    uint32_t magic = 0;
+    if (size < sizeof(magic))
+        return false;
+
+    memcpy(&magic, data, sizeof(magic));
+
+    return magic == EXECUTABLE_MAGIC;
+}
+
+ErrorCode ReadExecutable(const byte* data, size_t size, Executable* executable)
+{
+    MyAssertSoft(data || size == 0, ERROR_NULLPTR);
+    MyAssertSoft(executable, ERROR_NULLPTR);
+
+    ExecutableHeader header = {};
+    if (size < sizeof(header))
+        return ERROR_BAD_SIZE;
+
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != EXECUTABLE_MAGIC || header.version != EXECUTABLE_VERSION)
+        return ERROR_BAD_SIZE;
+
+    if (header.checksum != _headerChecksum(&header))
+        return ERROR_BAD_HASH;
+
+    // commands are only ever added, so older code runs as it is
+    if (header.commandSetVersion > COMMAND_SET_VERSION || header.format > FORMAT_ALIGNED)
+        return ERROR_BAD_VALUE;
+
+    if (header.sections[SECTION_CODE].offset % EXECUTABLE_PAGE_SIZE != 0)
+        return ERROR_BAD_SIZE;
+
+    *executable = {};
+    executable->format     = (CodeFormat)header.format;
+    executable->entryPoint = header.entryPoint;
+
+    for (size_t i = 0; i < SECTIONS_COUNT; i++)
+    {
+        const ExecutableSection* section = &header.sections[i];
+
+        if (section->offset > size || section->size > size - section->offset)
+            return ERROR_BAD_SIZE;
+
+        if (section->checksum != CalculateHash64(data + section->offset, section->size, EXECUTABLE_CHECKSUM_SEED))
+            return ERROR_BAD_HASH;
+
+        executable->sections[i] = data + section->offset;
+        executable->sizes[i]    = section->size;
+    }
+
+    return EVERYTHING_FINE;
+}
+
+static byte* _createSymbolSection(const LabelTable* symbols, CodeFormat format, size_t* size)
+{
+    *size = 0;
+    for (size_t i = 0; i < symbols->size; i++)
+        if (symbols->labels[i].isDefined)
+            *size += SYMBOL_RECORD_SIZE + symbols->labels[i].name.length;
+
+    // one more byte, so that an empty section gets a buffer too
+    byte* data = (byte*)calloc(*size + 1, sizeof(*data));
+    if (!data)
+        return NULL;
+
+    byte* where = data;
+    for (size_t i = 0; i < symbols->size; i++)
+    {
+        const Label* symbol = &symbols->labels[i];
+        if (!symbol->isDefined)
+            continue;
+
+        uint64_t position   = (uint64_t)symbol->codePosition / CodeUnitSize(format);
+        uint32_t nameLength = (uint32_t)symbol->name.length;
+
+        memcpy(where, &position, sizeof(position));
+        where += sizeof(position);
+        memcpy(where, &nameLength, sizeof(nameLength));
+        where += sizeof(nameLength);
+        memcpy(where, symbol->name.text, nameLength);
+        where += nameLength;
+    }
+
+    return data;
+}
+
+static ErrorCode _writePadded(FILE* file, size_t* filePosition, const byte* data, size_t size, size_t offset)
+{
+    while (*filePosition < offset)
+    {
+        size_t padding = offset - *filePosition;
+        if (padding > sizeof(PADDING))
+            padding = sizeof(PADDING);
+
+        if (fwrite(PADDING, sizeof(*PADDING), padding, file) != padding)
+            return ERROR_BAD_FILE;
+
+        *filePosition += padding;
+    }
+
+    if (size && fwrite(data, sizeof(*data), size, file) != size)
+        return ERROR_BAD_FILE;
+
+    *filePosition += size;
+
+    return EVERYTHING_FINE;
+}
+
+static size_t _alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint64_t _headerChecksum(const ExecutableHeader* header)
+{
+    return CalculateHash64(header, offsetof(ExecutableHeader, checksum), EXECUTABLE_CHECKSUM_SEED);
+}
@@ -0,0 +1,191 @@
+#include <string.h>
+#include "LabelTable.hpp"
+
+static const unsigned int LABEL_HASH_SEED = 0xD060;
+static const size_t       MIN_SLOTS_COUNT = 16;
+static const size_t       NAME_BLOCK_SIZE = 1 << 16;
+
+static ErrorCode _rehash(LabelTable* table, size_t slotsCount);
+
+static size_t _findSlot(const LabelTable* table, const char* name, size_t length, unsigned int hash,
+                        size_t* probes);
+
+static const char* _copyName(LabelTable* table, const char* name, size_t length);
+
+ErrorCode LabelTableInit(LabelTable* table, size_t capacity, bool copyNames)
+{
+    MyAssertSoft(table, ERROR_NULLPTR);
+
+    *table = {};
+    table->copyNames = copyNames;
+
+    if (capacity == 0)
+        capacity = MIN_SLOTS_COUNT / 2;
+
+    table->labels = (Label*)calloc(capacity, sizeof(*table->labels));
+    MyAssertSoft(table->labels, ERROR_NO_MEMORY);
+
+    table->capacity = capacity;
+
+    size_t slotsCount = MIN_SLOTS_COUNT;
+    while (slotsCount < 2 * capacity)
+        slotsCount *= 2;
+
+    return _rehash(table, slotsCount);
+}
+
+void LabelTableDestroy(LabelTable* table)
+{
+    MyAssertHard(table, ERROR_NULLPTR, );
+
+    free(table->labels);
+    free(table->slots);
+
+    while (table->nameBlocks)
+    {
+        NameBlock* next = table->nameBlocks->next;
+        free(table->nameBlocks);
+        table->nameBlocks = next;
+    }
+
+    *table = {};
+}
+
+LabelIndexResult LabelTableInsert(LabelTable* table, const char* name, size_t length)
+{
+    MyAssertSoftResult(table, LABEL_NOT_FOUND, ERROR_NULLPTR);
+    MyAssertSoftResult(name,  LABEL_NOT_FOUND, ERROR_NULLPTR);
+
+    unsigned int hash = CalculateHash(name, length, LABEL_HASH_SEED);
+
+    table->lookups++;
+
+    size_t slot = _findSlot(table, name, length, hash, &table->probes);
+    if (table->slots[slot] != LABEL_NOT_FOUND)
+        return {table->slots[slot], EVERYTHING_FINE};
+
+    if (table->size == table->capacity)
+    {
+        size_t newCapacity = table->capacity * 2;
+        Label* newLabels   = (Label*)realloc(table->labels, newCapacity * sizeof(*newLabels));
+        MyAssertSoftResult(newLabels, LABEL_NOT_FOUND, ERROR_NO_MEMORY);
+
+        table->labels   = newLabels;
+        table->capacity = newCapacity;
+    }
+
+    if (table->copyNames)
+    {
+        name = _copyName(table, name, length);
+        MyAssertSoftResult(name, LABEL_NOT_FOUND, ERROR_NO_MEMORY);
+    }
+
+    size_t index = table->size++;
+
+    table->labels[index] = {{name, length}, hash, 0, false};
+    table->slots[slot]   = index;
+
+    // keeping load factor under 1/2 so probe sequences stay short
+    if (2 * table->size > table->slotsCount)
+        return {index, _rehash(table, table->slotsCount * 2)};
+
+    return {index, EVERYTHING_FINE};
+}
+
+LabelIndexResult LabelTableDefine(LabelTable* table, const char* name, size_t length, double codePosition)
+{
+    LabelIndexResult indexRes = LabelTableInsert(table, name, length);
+    RETURN_ERROR_RESULT(indexRes, LABEL_NOT_FOUND);
+
+    Label* label = &table->labels[indexRes.value];
+    if (!label->isDefined)
+    {
+        label->codePosition = codePosition;
+        label->isDefined    = true;
+    }
+
+    return indexRes;
+}
+
+size_t LabelTableFind(const LabelTable* table, const char* name, size_t length)
+{
+    MyAssertHard(table, ERROR_NULLPTR);
+    MyAssertHard(name,  ERROR_NULLPTR);
+
+    unsigned int hash = CalculateHash(name, length, LABEL_HASH_SEED);
+
+    size_t probes = 0;
+
+    return table->slots[_findSlot(table, name, length, hash, &probes)];
+}
+
+static size_t _findSlot(const LabelTable* table, const char* name, size_t length, unsigned int hash,
+                        size_t* probes)
+{
+    size_t mask = table->slotsCount - 1;
+    size_t slot = hash & mask;
+
+    (*probes)++;
+
+    while (table->slots[slot] != LABEL_NOT_FOUND)
+    {
+        const Label* label = &table->labels[table->slots[slot]];
+
+        if (label->hash == hash && label->name.length == length &&
+            memcmp(label->name.text, name, length) == 0)
+            break;
+
+        slot = (slot + 1) & mask;
+        (*probes)++;
+    }
+
+    return slot;
+}
+
+static const char* _copyName(LabelTable* table, const char* name, size_t length)
+{
+    NameBlock* block = table->nameBlocks;
+
+    if (!block || block->capacity - block->used < length)
+    {
+        size_t capacity = length > NAME_BLOCK_SIZE ? length : NAME_BLOCK_SIZE;
+
+        block = (NameBlock*)malloc(sizeof(*block) + capacity);
+        if (!block)
+            return NULL;
+
+        *block = {table->nameBlocks, 0, capacity};
+        table->nameBlocks = block;
+    }
+
+    char* copy = (char*)(block + 1) + block->used;
+    memcpy(copy, name, length);
+    block->used += length;
+
+    return copy;
+}
+
+static ErrorCode _rehash(LabelTable* table, size_t slotsCount)
+{
+    size_t* slots = (size_t*)malloc(slotsCount * sizeof(*slots));
+    MyAssertSoft(slots, ERROR_NO_MEMORY);
+
+    memset(slots, 0xFF, slotsCount * sizeof(*slots));
+
+    size_t mask = slotsCount - 1;
+    for (size_t i = 0; i < table->size; i++)
+    {
+        size_t slot = table->labels[i].hash & mask;
+        while (slots[slot] != LABEL_NOT_FOUND)
+            slot = (slot + 1) & mask;
+
+        slots[slot] = i;
+    }
+
+    free(table->slots);
+
+    table->slots      = slots;
+    table->slotsCount = slotsCount;
+
+    return EVERYTHING_FINE;
+}
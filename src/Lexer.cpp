@@ -0,0 +1,268 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <charconv>
+#include "Lexer.hpp"
+
+// strtod needs a terminated string, shorter words are copied to the stack
+static const size_t MAX_NUMBER_LENGTH = 63;
+
+// integers up to 2^53 and powers of ten up to 1e22 are exact doubles
+static const uint64_t MAX_EXACT_MANTISSA = 1ULL << 53;
+static const int      MAX_EXACT_POWER    = 22;
+static const size_t   MAX_MANTISSA_DIGITS = 19;
+
+static const double EXACT_POWERS_OF_TEN[MAX_EXACT_POWER + 1] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static bool _isSpace(char c);
+
+static bool _isSeparator(char c);
+
+static bool _parseRegister(const String* word, byte* regNum);
+
+static bool _parseNumber(const String* word, double* number);
+
+static bool _parseShortDecimal(const String* word, double* number);
+
+static bool _parseAnyNumber(const String* word, double* number);
+
+static bool _parseWithStrtod(const String* word, double* number);
+
+Lexer CreateLexer(const String* line)
+{
+    MyAssertHard(line, ERROR_NULLPTR);
+
+    return {line->text, line->text + line->length, true};
+}
+
+Lexeme LexerNext(Lexer* lexer)
+{
+    MyAssertHard(lexer, ERROR_NULLPTR);
+
+    while (lexer->position < lexer->end && _isSpace(*lexer->position))
+        lexer->position++;
+
+    Lexeme lexeme = {LEXEME_END, {lexer->position, 0}, 0, 0};
+
+    if (lexer->position == lexer->end)
+        return lexeme;
+
+    switch (*lexer->position)
+    {
+        case '[':
+            lexeme.type = LEXEME_OPEN_BRACKET;
+            break;
+        case ']':
+            lexeme.type = LEXEME_CLOSE_BRACKET;
+            break;
+        case '+':
+            lexeme.type = LEXEME_PLUS;
+            break;
+        default:
+            break;
+    }
+
+    if (lexeme.type != LEXEME_END)
+    {
+        lexeme.text.length = 1;
+        lexer->position++;
+        lexer->isLineStart = false;
+
+        return lexeme;
+    }
+
+    while (lexer->position < lexer->end && !_isSeparator(*lexer->position))
+        lexer->position++;
+
+    lexeme.text.length = (size_t)(lexer->position - lexeme.text.text);
+
+    if (lexer->isLineStart)
+        lexeme.type = LEXEME_MNEMONIC;
+    else if (_parseRegister(&lexeme.text, &lexeme.regNum))
+        lexeme.type = LEXEME_REGISTER;
+    else if (_parseNumber(&lexeme.text, &lexeme.number))
+        lexeme.type = LEXEME_NUMBER;
+    else
+        lexeme.type = LEXEME_LABEL;
+
+    lexer->isLineStart = false;
+
+    return lexeme;
+}
+
+static bool _isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+static bool _isSeparator(char c)
+{
+    return _isSpace(c) || c == '[' || c == ']' || c == '+';
+}
+
+static bool _parseRegister(const String* word, byte* regNum)
+{
+    if (word->length != 3 || word->text[0] != 'r' || word->text[2] != 'x' ||
+        !('a' <= word->text[1] && word->text[1] <= 'z'))
+        return false;
+
+    *regNum = (byte)(word->text[1] - 'a' + 1);
+
+    return true;
+}
+
+static bool _parseNumber(const String* word, double* number)
+{
+    if (word->length == 0)
+        return false;
+
+    return _parseShortDecimal(word, number) || _parseAnyNumber(word, number);
+}
+
+static bool _parseShortDecimal(const String* word, double* number)
+{
+    const char* where = word->text;
+    const char* end   = word->text + word->length;
+
+    bool isNegative = *where == '-';
+    if (isNegative)
+        where++;
+
+    uint64_t mantissa = 0;
+    size_t   digits   = 0;
+
+    while (where < end && '0' <= *where && *where <= '9' && digits < MAX_MANTISSA_DIGITS)
+    {
+        mantissa = mantissa * 10 + (uint64_t)(*where++ - '0');
+        digits++;
+    }
+
+    // most immediates are small integers
+    if (where == end && digits != 0 && mantissa <= MAX_EXACT_MANTISSA)
+    {
+        *number = isNegative ? -(double)mantissa : (double)mantissa;
+        return true;
+    }
+
+    int exponent = 0;
+
+    if (where < end && *where == '.')
+    {
+        where++;
+        while (where < end && '0' <= *where && *where <= '9' && digits < MAX_MANTISSA_DIGITS)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*where++ - '0');
+            digits++;
+            exponent--;
+        }
+    }
+
+    if (digits == 0)
+        return false;
+
+    if (where < end && (*where == 'e' || *where == 'E'))
+    {
+        where++;
+
+        bool isExponentNegative = where < end && *where == '-';
+        if (isExponentNegative)
+            where++;
+
+        const char* exponentStart = where;
+        int         exponentValue = 0;
+
+        while (where < end && '0' <= *where && *where <= '9' && exponentValue <= MAX_EXACT_POWER * 2)
+            exponentValue = exponentValue * 10 + (*where++ - '0');
+
+        if (where == exponentStart)
+            return false;
+
+        exponent += isExponentNegative ? -exponentValue : exponentValue;
+    }
+
+    // one multiplication or division of exact numbers is rounded correctly, longer words go the slow way
+    if (where != end || mantissa > MAX_EXACT_MANTISSA || exponent < -MAX_EXACT_POWER || exponent > MAX_EXACT_POWER)
+        return false;
+
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / EXACT_POWERS_OF_TEN[-exponent] : value * EXACT_POWERS_OF_TEN[exponent];
+
+    *number = isNegative ? -value : value;
+
+    return true;
+}
+
+#ifdef __cpp_lib_to_chars
+
+static bool _parseAnyNumber(const String* word, double* number)
+{
+    const char* where = word->text;
+    const char* end   = word->text + word->length;
+
+    bool isNegative = *where == '-';
+
+    // from_chars takes hex floats without the prefix
+    std::chars_format format = std::chars_format::general;
+    if (end - where > 2 + isNegative && where[isNegative] == '0' && (where[isNegative + 1] | 0x20) == 'x')
+    {
+        format = std::chars_format::hex;
+        where += 2 + isNegative;
+
+        // strtod takes only digits after the prefix, not a sign or inf
+        bool isDigit = ('0' <= *where && *where <= '9') || ('a' <= (*where | 0x20) && (*where | 0x20) <= 'f');
+        if (!isDigit && *where != '.')
+            return false;
+    }
+
+    std::from_chars_result result = std::from_chars(where, end, *number, format);
+
+    // values which round to 0 or infinity and payloads of NaNs are left to strtod to get the same bits
+    if (result.ec == std::errc::result_out_of_range || (result.ec == std::errc() && *number != *number))
+        return _parseWithStrtod(word, number);
+
+    if (result.ec != std::errc() || result.ptr != end)
+        return false;
+
+    if (format == std::chars_format::hex && isNegative)
+        *number = -*number;
+
+    return true;
+}
+
+#else
+
+static bool _parseAnyNumber(const String* word, double* number)
+{
+    return _parseWithStrtod(word, number);
+}
+
+#endif
+
+static bool _parseWithStrtod(const String* word, double* number)
+{
+    char  buffer[MAX_NUMBER_LENGTH + 1] = "";
+    char* copy = buffer;
+
+    if (word->length > MAX_NUMBER_LENGTH)
+    {
+        copy = (char*)calloc(word->length + 1, sizeof(*copy));
+        if (!copy)
+            return false;
+    }
+
+    memcpy(copy, word->text, word->length);
+
+    char* numberEnd = NULL;
+    *number = strtod(copy, &numberEnd);
+
+    bool isNumber = numberEnd == copy + word->length;
+
+    if (copy != buffer)
+        free(copy);
+
+    return isNumber;
+}
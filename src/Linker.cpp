@@ -0,0 +1,155 @@
+#include "Linker.hpp"
+#include "AssemblerState.hpp"
+#include "ObjectFile.hpp"
+#include "Executable.hpp"
+
+static const size_t SYMBOLS_START_CAPACITY = 64;
+
+static ErrorCode _addModule(AssemblerState* state, const char* objectFilePath, bool isFirst, FILE* diagnostics);
+
+static ErrorCode _resolveRelocations(AssemblerState* state, const char* const* objectFilePaths,
+                                     const size_t* relocationsEnds, FILE* diagnostics);
+
+static void _printLinkError(FILE* diagnostics, ErrorCode error, const char* objectFilePath, const char* message,
+                            const Label* symbol);
+
+ErrorCode Link(const char* const* objectFilePaths, size_t objectsCount, const char* byteCodeFilePath,
+               bool container, FILE* diagnostics)
+{
+    MyAssertSoft(objectFilePaths, ERROR_NULLPTR);
+    MyAssertSoft(byteCodeFilePath, ERROR_NULLPTR);
+
+    if (!diagnostics)
+        diagnostics = stdout;
+
+    AssemblerState state = {};
+
+    // objects are freed as soon as they are merged, so symbols can't keep views of them
+    ErrorCode error = LabelTableInit(&state.labels, SYMBOLS_START_CAPACITY, true);
+
+    size_t* relocationsEnds = (size_t*)calloc(objectsCount + 1, sizeof(*relocationsEnds));
+    if (!error && !relocationsEnds)
+        error = ERROR_NO_MEMORY;
+
+    for (size_t i = 0; i < objectsCount && !error; i++)
+    {
+        error = _addModule(&state, objectFilePaths[i], i == 0, diagnostics);
+
+        relocationsEnds[i] = state.fixupsCount;
+    }
+
+    if (!error)
+        error = _resolveRelocations(&state, objectFilePaths, relocationsEnds, diagnostics);
+
+    if (!error)
+    {
+        FILE* binaryFile = fopen(byteCodeFilePath, "wb");
+
+        if (!binaryFile)
+            error = ERROR_BAD_FILE;
+        else
+        {
+            if (container)
+                error = WriteExecutable(binaryFile, state.format, state.codeArray, state.codePosition, &state.labels);
+            else if (state.codePosition && fwrite(state.codeArray, sizeof(*state.codeArray), state.codePosition,
+                                                  binaryFile) != state.codePosition)
+                error = ERROR_BAD_FILE;
+
+            if (fclose(binaryFile) != 0 && !error)
+                error = ERROR_BAD_FILE;
+        }
+    }
+
+    free(relocationsEnds);
+    DestroyAssemblerState(&state);
+
+    return error;
+}
+
+static ErrorCode _addModule(AssemblerState* state, const char* objectFilePath, bool isFirst, FILE* diagnostics)
+{
+    AssemblerState module = {};
+    byte*          data   = NULL;
+
+    ErrorCode error = ReadObjectFile(objectFilePath, &module, &data);
+
+    if (error)
+        _printLinkError(diagnostics, error, objectFilePath, "is not a valid object", NULL);
+    else if (isFirst)
+        state->format = module.format;
+    else if (state->format != module.format)
+    {
+        error = ERROR_BAD_VALUE;
+        _printLinkError(diagnostics, error, objectFilePath, "has another code format", NULL);
+    }
+
+    // the merge lets the first definition win, the linker doesn't accept a second one at all
+    for (size_t i = 0; i < module.labels.size && !error; i++)
+    {
+        const Label* symbol = &module.labels.labels[i];
+        if (!symbol->isDefined)
+            continue;
+
+        size_t index = LabelTableFind(&state->labels, symbol->name.text, symbol->name.length);
+
+        if (index != LABEL_NOT_FOUND && state->labels.labels[index].isDefined)
+        {
+            error = ERROR_SYNTAX;
+            _printLinkError(diagnostics, error, objectFilePath, "redefines symbol", symbol);
+        }
+    }
+
+    if (!error)
+        error = MergeAssemblerState(state, &module, 0);
+
+    DestroyAssemblerState(&module);
+    free(data);
+
+    return error;
+}
+
+static ErrorCode _resolveRelocations(AssemblerState* state, const char* const* objectFilePaths,
+                                     const size_t* relocationsEnds, FILE* diagnostics)
+{
+    size_t module = 0;
+
+    for (size_t i = 0; i < state->fixupsCount; i++)
+    {
+        const Fixup* relocation = &state->fixups[i];
+        const Label* symbol     = &state->labels.labels[relocation->labelIndex];
+
+        while (relocationsEnds[module] <= i)
+            module++;
+
+        if (!symbol->isDefined)
+        {
+            _printLinkError(diagnostics, ERROR_NOT_FOUND, objectFilePaths[module], "imports undefined symbol", symbol);
+            return ERROR_NOT_FOUND;
+        }
+
+        ErrorCode patchError = PatchImmediate(state->codeArray + relocation->codePosition, relocation->width,
+                                              state->format,
+                                              symbol->codePosition / (double)CodeUnitSize(state->format));
+        if (patchError)
+        {
+            _printLinkError(diagnostics, patchError, objectFilePaths[module], "can't relocate symbol", symbol);
+            return patchError;
+        }
+    }
+
+    state->fixupsCount = 0;
+
+    return EVERYTHING_FINE;
+}
+
+static void _printLinkError(FILE* diagnostics, ErrorCode error, const char* objectFilePath, const char* message,
+                            const Label* symbol)
+{
+    if (symbol)
+        fprintf(diagnostics, CONSOLE_COLOR_FORMAT "%s: %s %s \"%.*s\"\n" CONSOLE_COLOR_FORMAT,
+                (int)COLOR_RED, ERROR_CODE_NAMES[error], objectFilePath, message,
+                (int)symbol->name.length, symbol->name.text, (int)COLOR_WHITE);
+    else
+        fprintf(diagnostics, CONSOLE_COLOR_FORMAT "%s: %s %s\n" CONSOLE_COLOR_FORMAT,
+                (int)COLOR_RED, ERROR_CODE_NAMES[error], objectFilePath, message, (int)COLOR_WHITE);
+}
@@ -0,0 +1,353 @@
+#include <string.h>
+#include "ObjectFile.hpp"
+
+static const uint8_t LISTING_LABEL_LINE = 0xFF;
+
+static const uint32_t OBJECT_MAGIC       = 0x424F4744; // "DGOB"
+static const uint32_t OBJECT_VERSION     = 1;
+static const size_t   OBJECT_BUFFER_SIZE = 1 << 16;
+
+static const size_t BLOCK_HEADER_SIZE  = 4 * sizeof(uint32_t);
+static const size_t LABEL_RECORD_SIZE  = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(double);
+static const size_t FIXUP_RECORD_SIZE  = 3 * sizeof(uint32_t) + sizeof(uint8_t);
+static const size_t LISTING_LINE_SIZE  = 2 * sizeof(uint32_t) + sizeof(uint8_t);
+
+/** @struct ObjectHeader
+ * @brief Start of an object file, the module's block comes after it.
+ */
+struct ObjectHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+};
+
+/** @struct BlockReader
+ * @brief Cursor over serialized data which remembers if it ran out of it.
+ */
+struct BlockReader
+{
+    const byte* data;
+    const byte* end;
+    bool failed;
+};
+
+static byte* _readFile(const char* path, size_t* size);
+
+static char* _writeUint32(char* where, size_t value);
+
+static char* _writeUint8(char* where, uint8_t value);
+
+static char* _writeDouble(char* where, double value);
+
+static const byte* _readBytes(BlockReader* reader, size_t size);
+
+static uint32_t _readUint32(BlockReader* reader);
+
+static uint8_t _readUint8(BlockReader* reader);
+
+static double _readDouble(BlockReader* reader);
+
+size_t AssembledBlockSize(const AssemblerState* block)
+{
+    MyAssertHard(block, ERROR_NULLPTR);
+
+    size_t size = BLOCK_HEADER_SIZE + block->codePosition +
+                  block->labels.size * LABEL_RECORD_SIZE +
+                  block->fixupsCount * FIXUP_RECORD_SIZE +
+                  block->listingCount * LISTING_LINE_SIZE;
+
+    for (size_t i = 0; i < block->labels.size; i++)
+        size += block->labels.labels[i].name.length;
+
+    return size;
+}
+
+ErrorCode WriteAssembledBlock(OutputBuffer* output, const AssemblerState* block)
+{
+    MyAssertSoft(output, ERROR_NULLPTR);
+    MyAssertSoft(block,  ERROR_NULLPTR);
+
+    // records keep positions in 32 bits, blocks are much smaller than that
+    if (block->codePosition > UINT32_MAX || block->labels.size > UINT32_MAX)
+        return ERROR_BAD_SIZE;
+
+    size_t size  = AssembledBlockSize(block);
+    char*  where = OutputBufferReserve(output, size);
+    if (!where)
+        return output->error;
+
+    where = _writeUint32(where, block->codePosition);
+    where = _writeUint32(where, block->labels.size);
+    where = _writeUint32(where, block->fixupsCount);
+    where = _writeUint32(where, block->listingCount);
+
+    if (block->codePosition)
+        memcpy(where, block->codeArray, block->codePosition);
+    where += block->codePosition;
+
+    for (size_t i = 0; i < block->labels.size; i++)
+    {
+        const Label* label = &block->labels.labels[i];
+
+        where = _writeUint32(where, label->name.length);
+        where = _writeUint8 (where, label->isDefined);
+        where = _writeDouble(where, label->codePosition);
+
+        memcpy(where, label->name.text, label->name.length);
+        where += label->name.length;
+    }
+
+    for (size_t i = 0; i < block->fixupsCount; i++)
+    {
+        const Fixup* fixup = &block->fixups[i];
+
+        where = _writeUint32(where, fixup->codePosition);
+        where = _writeUint32(where, fixup->labelIndex);
+        where = _writeUint32(where, fixup->tokenIndex);
+        where = _writeUint8 (where, (uint8_t)fixup->width);
+    }
+
+    for (size_t i = 0; i < block->listingCount; i++)
+    {
+        const ListingLine* line = &block->listing[i];
+
+        where = _writeUint32(where, line->tokenIndex);
+        where = _writeUint32(where, line->codePosition);
+        where = _writeUint8 (where, line->commandInfo ? (uint8_t)(line->commandInfo - COMMANDS) : LISTING_LABEL_LINE);
+    }
+
+    OutputBufferCommit(output, where);
+
+    return EVERYTHING_FINE;
+}
+
+ErrorCode ReadAssembledBlock(const byte* data, size_t size, AssemblerState* block)
+{
+    MyAssertSoft(data,  ERROR_NULLPTR);
+    MyAssertSoft(block, ERROR_NULLPTR);
+
+    BlockReader reader = {data, data + size, false};
+
+    size_t codeSize     = _readUint32(&reader);
+    size_t labelsCount  = _readUint32(&reader);
+    size_t fixupsCount  = _readUint32(&reader);
+    size_t listingCount = _readUint32(&reader);
+
+    // counts are checked before anything is allocated for them
+    if (codeSize + labelsCount * LABEL_RECORD_SIZE + fixupsCount * FIXUP_RECORD_SIZE +
+        listingCount * LISTING_LINE_SIZE > size)
+        return ERROR_BAD_SIZE;
+
+    const byte* code = _readBytes(&reader, codeSize);
+    if (reader.failed)
+        return ERROR_BAD_SIZE;
+
+    RETURN_ERROR(GrowArray((void**)&block->codeArray, &block->codeCapacity, codeSize, sizeof(*block->codeArray)));
+    if (codeSize)
+        memcpy(block->codeArray, code, codeSize);
+    block->codePosition = codeSize;
+
+    RETURN_ERROR(LabelTableInit(&block->labels, labelsCount, false));
+
+    for (size_t i = 0; i < labelsCount && !reader.failed; i++)
+    {
+        size_t nameLength   = _readUint32(&reader);
+        bool   isDefined    = _readUint8 (&reader);
+        double codePosition = _readDouble(&reader);
+
+        const char* name = (const char*)_readBytes(&reader, nameLength);
+        if (reader.failed)
+            break;
+
+        LabelIndexResult indexRes = isDefined ? LabelTableDefine(&block->labels, name, nameLength, codePosition) :
+                                                LabelTableInsert(&block->labels, name, nameLength);
+        RETURN_ERROR(indexRes.error);
+
+        // names are unique in a block, so labels keep their indexes
+        if (indexRes.value != i)
+            return ERROR_BAD_SIZE;
+    }
+
+    RETURN_ERROR(GrowArray((void**)&block->fixups, &block->fixupsCapacity, fixupsCount, sizeof(*block->fixups)));
+
+    for (size_t i = 0; i < fixupsCount && !reader.failed; i++)
+    {
+        Fixup fixup = {};
+
+        fixup.codePosition = _readUint32(&reader);
+        fixup.labelIndex   = _readUint32(&reader);
+        fixup.tokenIndex   = _readUint32(&reader);
+        fixup.width        = (ImmediateWidth)_readUint8(&reader);
+
+        if (fixup.labelIndex >= labelsCount || fixup.width > IMMEDIATE_DOUBLE ||
+            fixup.codePosition + ImmediateSize(fixup.width, block->format) > codeSize)
+            return ERROR_BAD_SIZE;
+
+        block->fixups[block->fixupsCount++] = fixup;
+    }
+
+    if (block->writeListing)
+        RETURN_ERROR(GrowArray((void**)&block->listing, &block->listingCapacity,
+                               listingCount, sizeof(*block->listing)));
+
+    for (size_t i = 0; i < listingCount && !reader.failed; i++)
+    {
+        ListingLine line = {};
+
+        line.tokenIndex   = _readUint32(&reader);
+        line.codePosition = _readUint32(&reader);
+
+        uint8_t command = _readUint8(&reader);
+        if (command != LISTING_LABEL_LINE)
+        {
+            if (command >= COMMANDS_COUNT || line.codePosition >= codeSize)
+                return ERROR_BAD_SIZE;
+
+            line.commandInfo = &COMMANDS[command];
+        }
+
+        if (block->writeListing)
+            block->listing[block->listingCount++] = line;
+    }
+
+    if (reader.failed || reader.data != reader.end)
+        return ERROR_BAD_SIZE;
+
+    return EVERYTHING_FINE;
+}
+
+ErrorCode WriteObjectFile(FILE* file, const AssemblerState* module)
+{
+    MyAssertSoft(file,   ERROR_NULLPTR);
+    MyAssertSoft(module, ERROR_NULLPTR);
+
+    OutputBuffer output = {};
+    RETURN_ERROR(OutputBufferInit(&output, file, OBJECT_BUFFER_SIZE));
+
+    ObjectHeader header = {OBJECT_MAGIC, OBJECT_VERSION, (uint32_t)module->format};
+    OutputBufferWrite(&output, (const char*)&header, sizeof(header));
+
+    // listing lines point into the module's source which the linker doesn't have
+    AssemblerState symbols = *module;
+    symbols.listingCount = 0;
+
+    ErrorCode error = WriteAssembledBlock(&output, &symbols);
+
+    ErrorCode flushError = OutputBufferDestroy(&output);
+
+    return error ? error : flushError;
+}
+
+ErrorCode ReadObjectFile(const char* objectFilePath, AssemblerState* module, byte** data)
+{
+    MyAssertSoft(objectFilePath, ERROR_NULLPTR);
+    MyAssertSoft(module,         ERROR_NULLPTR);
+    MyAssertSoft(data,           ERROR_NULLPTR);
+
+    size_t size = 0;
+    *data = _readFile(objectFilePath, &size);
+    if (!*data)
+        return ERROR_BAD_FILE;
+
+    ObjectHeader header = {};
+    if (size < sizeof(header))
+        return ERROR_BAD_SIZE;
+
+    memcpy(&header, *data, sizeof(header));
+
+    if (header.magic != OBJECT_MAGIC || header.version != OBJECT_VERSION ||
+        header.format > FORMAT_ALIGNED)
+        return ERROR_BAD_SIZE;
+
+    module->format = (CodeFormat)header.format;
+
+    return ReadAssembledBlock(*data + sizeof(header), size - sizeof(header), module);
+}
+
+static byte* _readFile(const char* path, size_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    *size = GetFileSize(path);
+
+    // one more byte, so that empty files get a buffer too
+    byte* data = (byte*)calloc(*size + 1, sizeof(*data));
+
+    if (data && fread(data, sizeof(*data), *size, file) != *size)
+    {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+
+    return data;
+}
+
+static char* _writeUint32(char* where, size_t value)
+{
+    uint32_t value32 = (uint32_t)value;
+    memcpy(where, &value32, sizeof(value32));
+
+    return where + sizeof(value32);
+}
+
+static char* _writeUint8(char* where, uint8_t value)
+{
+    *where = (char)value;
+
+    return where + sizeof(value);
+}
+
+static char* _writeDouble(char* where, double value)
+{
+    memcpy(where, &value, sizeof(value));
+
+    return where + sizeof(value);
+}
+
+static const byte* _readBytes(BlockReader* reader, size_t size)
+{
+    if (reader->failed || (size_t)(reader->end - reader->data) < size)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+
+    const byte* bytes = reader->data;
+    reader->data += size;
+
+    return bytes;
+}
+
+static uint32_t _readUint32(BlockReader* reader)
+{
+    uint32_t value = 0;
+
+    const byte* bytes = _readBytes(reader, sizeof(value));
+    if (bytes)
+        memcpy(&value, bytes, sizeof(value));
+
+    return value;
+}
+
+static uint8_t _readUint8(BlockReader* reader)
+{
+    const byte* bytes = _readBytes(reader, sizeof(uint8_t));
+
+    return bytes ? *bytes : 0;
+}
+
+static double _readDouble(BlockReader* reader)
+{
+    double value = 0;
+
+    const byte* bytes = _readBytes(reader, sizeof(value));
+    if (bytes)
+        memcpy(&value, bytes, sizeof(value));
+
+    return value;
+}
@@ -1,4 +1,7 @@
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -8,9 +11,41 @@
 #include "StringFunctions.hpp"
 #include "Sort.hpp"
 
-size_t _countTokens(const char* string, char terminator);
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
 
-const String* _split(const char* string, size_t numOfTokens, char terminator);
+/** @struct SplitState
+ * @brief State of the single pass split.
+ *
+ * @var SplitState::tokenStart - where the current token starts.
+ * @var SplitState::comment - first comment symbol in the current token or NULL.
+ * @var SplitState::label - first label symbol in the current token or NULL.
+ * @var SplitState::terminator - what tokens are separated with.
+ * @var SplitState::tokens, marks - growable arrays of the result.
+ * @var SplitState::numberOfTokens - number of tokens found.
+ * @var SplitState::capacity - capacity of tokens and marks.
+ */
+struct SplitState
+{
+    const char* tokenStart;
+    const char* comment;
+    const char* label;
+    char terminator;
+
+    String*     tokens;
+    TokenMarks* marks;
+    size_t      numberOfTokens;
+    size_t      capacity;
+};
+
+void _split(Text* text, size_t size, char terminator);
+
+void _pushToken(SplitState* state, const char* tokenEnd);
+
+const char* _splitScalar(SplitState* state, const char* string, const char* end);
+
+const char* _splitVectorized(SplitState* state, const char* string, const char* end);
 
 int _stringCompareStartToEnd(const void* s1, const void* s2);
 
@@ -36,9 +71,66 @@ Text CreateText(const char* path, char terminator)
 
     text.rawText = rawText;
 
-    text.numberOfTokens = _countTokens(rawText, terminator);
+    _split(&text, text.size + 1, terminator);
+
+    return text;
+}
+
+Text CreateTextMapped(const char* path, char terminator)
+{
+    MyAssertHard(path, ERROR_NULLPTR);
+
+    Text text = {};
+    text.storage = TEXT_MAPPED;
+
+    // the caller decides what a missing file means, so it only gets an empty text
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return {};
+
+    struct stat fileStat = {};
+    if (fstat(fd, &fileStat) != 0)
+    {
+        close(fd);
+        return {};
+    }
+
+    text.size = (size_t)fileStat.st_size;
+
+    if (text.size == 0)
+        text.rawText = "";
+    else
+    {
+        void* mapping = mmap(NULL, text.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            return {};
+        }
+
+        madvise(mapping, text.size, MADV_SEQUENTIAL);
+
+        text.rawText = (const char*)mapping;
+    }
+
+    close(fd);
+
+    _split(&text, text.size, terminator);
+
+    return text;
+}
+
+Text CreateTextFromBuffer(const char* buffer, size_t size, char terminator)
+{
+    MyAssertHard(buffer, ERROR_NULLPTR);
+
+    Text text = {};
 
-    text.tokens = _split(text.rawText, text.numberOfTokens, terminator);
+    text.rawText = buffer;
+    text.size    = size;
+    text.storage = TEXT_BORROWED;
+
+    _split(&text, text.size, terminator);
 
     return text;
 }
@@ -47,11 +139,28 @@ void DestroyText(Text* text)
 {
     MyAssertHard(text, ERROR_NULLPTR, );
     free((void*)(text->tokens));
-    free((void*)(text->rawText));
+    free((void*)(text->marks));
+
+    switch (text->storage)
+    {
+        case TEXT_HEAP:
+            free((void*)(text->rawText));
+            break;
+        case TEXT_MAPPED:
+            if (text->size)
+                munmap((void*)text->rawText, text->size);
+            break;
+        case TEXT_BORROWED:
+        default:
+            break;
+    }
 }
 
 void SortTextTokens(Text* text, StringCompareMethod sortType)
 {
+    free((void*)(text->marks));
+    text->marks = NULL;
+
     switch (sortType)
     {
         case START_TO_END:
@@ -68,16 +177,19 @@ void SortTextTokens(Text* text, StringCompareMethod sortType)
 
 void PrintRawText(const Text* text, FILE* file)
 {
-    fputs(text->rawText, file);
+    if (text->storage == TEXT_HEAP)
+        fputs(text->rawText, file);
+    else
+        fwrite(text->rawText, sizeof(char), text->size, file);
 }
 
 void PrintTextTokens(const Text* text, FILE* file, char terminator)
 {
     for (size_t i = 0; i < text->numberOfTokens; i++)
     {
-        const char* line = text->tokens[i].text;
-        if (*line != terminator)
-            StringPrint(file, line, terminator);
+        const String* line = &text->tokens[i];
+        if (line->length && *line->text != terminator)
+            fprintf(file, "%.*s\n", (int)line->length, line->text);
     }
 }
 
@@ -91,43 +203,144 @@ int _stringCompareEndToStart(const void* s1, const void* s2)
     return StringCompare((String*)s1, (String*)s2, END_TO_START, IGNORE_CASE, IGNORED_SYMBOLS);
 }
 
-size_t _countTokens(const char* string, char terminator)
+void _split(Text* text, size_t size, char terminator)
+{
+    MyAssertHard(text, ERROR_NULLPTR, );
+    MyAssertHard(text->rawText, ERROR_NULLPTR, );
+
+    SplitState state = {};
+
+    state.tokenStart = text->rawText;
+    state.terminator = terminator;
+
+    // lines are rarely shorter, so the arrays seldom grow
+    state.capacity = size / 16 + 16;
+    state.tokens   = (String*)    calloc(state.capacity, sizeof(*state.tokens));
+    state.marks    = (TokenMarks*)calloc(state.capacity, sizeof(*state.marks));
+
+    MyAssertHard(state.tokens && state.marks, ERROR_NO_MEMORY);
+
+    const char* end = text->rawText + size;
+
+    const char* rest = _splitVectorized(&state, text->rawText, end);
+    _splitScalar(&state, rest, end);
+
+    _pushToken(&state, end);
+
+    text->tokens         = state.tokens;
+    text->marks          = state.marks;
+    text->numberOfTokens = state.numberOfTokens;
+}
+
+void _pushToken(SplitState* state, const char* tokenEnd)
+{
+    if (state->numberOfTokens == state->capacity)
+    {
+        state->capacity *= 2;
+        state->tokens = (String*)    realloc(state->tokens, state->capacity * sizeof(*state->tokens));
+        state->marks  = (TokenMarks*)realloc(state->marks,  state->capacity * sizeof(*state->marks));
+
+        MyAssertHard(state->tokens && state->marks, ERROR_NO_MEMORY);
+    }
+
+    const char* tokenStart = state->tokenStart;
+    size_t      length     = (size_t)(tokenEnd - tokenStart);
+
+    state->tokens[state->numberOfTokens] = {.text = tokenStart, .length = length};
+    state->marks [state->numberOfTokens] = {
+        .comment = state->comment ? (size_t)(state->comment - tokenStart) : length,
+        .label   = state->label   ? (size_t)(state->label   - tokenStart) : length,
+    };
+
+    state->numberOfTokens++;
+
+    state->tokenStart = tokenEnd + 1;
+    state->comment    = NULL;
+    state->label      = NULL;
+}
+
+static inline void _splitSymbol(SplitState* state, const char* symbol)
 {
-    MyAssertHard(string, ERROR_NULLPTR, );
+    char c = *symbol;
 
-    size_t tokens = 1;
-    const char* newTokenSymbol = strchr(string, terminator);
-    while (newTokenSymbol != NULL)
+    if (c == state->terminator)
+        _pushToken(state, symbol);
+    else if (c == COMMENT_SYMBOL)
     {
-        tokens++;
-        newTokenSymbol = strchr(newTokenSymbol + 1, terminator);
+        if (!state->comment)
+            state->comment = symbol;
     }
-    return tokens;
+    else if (!state->comment && !state->label)
+        state->label = symbol;
 }
 
-const String* _split(const char* string, size_t numOfTokens, char terminator)
+const char* _splitScalar(SplitState* state, const char* string, const char* end)
 {
-    MyAssertHard(string, ERROR_NULLPTR);
+    for (; string < end; string++)
+    {
+        char c = *string;
+        if (c == state->terminator || c == COMMENT_SYMBOL || c == LABEL_SYMBOL)
+            _splitSymbol(state, string);
+    }
+
+    return string;
+}
 
-    String* textTokens = (String*)calloc(numOfTokens, sizeof(textTokens[0]));
+#ifdef __SSE2__
+
+static const char* _splitSSE2(SplitState* state, const char* string, const char* end)
+{
+    const __m128i terminators = _mm_set1_epi8(state->terminator);
+    const __m128i comments    = _mm_set1_epi8(COMMENT_SYMBOL);
+    const __m128i labels      = _mm_set1_epi8(LABEL_SYMBOL);
 
-    MyAssertHard(textTokens, ERROR_NO_MEMORY);
+    for (; end - string >= (ptrdiff_t)sizeof(__m128i); string += sizeof(__m128i))
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)string);
+        __m128i hits  = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, terminators),
+                                                  _mm_cmpeq_epi8(block, comments)),
+                                                  _mm_cmpeq_epi8(block, labels));
 
-    const char* endCurToken = strchr(string, terminator);
+        for (unsigned mask = (unsigned)_mm_movemask_epi8(hits); mask; mask &= mask - 1)
+            _splitSymbol(state, string + __builtin_ctz(mask));
+    }
 
-    textTokens[0] = {.text = string,
-                     .length = (size_t)(endCurToken - string)};
+    return string;
+}
 
-    size_t i = 1;
+__attribute__((target("avx2")))
+static const char* _splitAVX2(SplitState* state, const char* string, const char* end)
+{
+    const __m256i terminators = _mm256_set1_epi8(state->terminator);
+    const __m256i comments    = _mm256_set1_epi8(COMMENT_SYMBOL);
+    const __m256i labels      = _mm256_set1_epi8(LABEL_SYMBOL);
 
-    while (endCurToken)
+    for (; end - string >= (ptrdiff_t)sizeof(__m256i); string += sizeof(__m256i))
     {
-        textTokens[i] = {};
-        textTokens[i].text = endCurToken + 1;
-        endCurToken = strchr(endCurToken + 1, terminator);
-        textTokens[i].length = endCurToken ? (size_t)(endCurToken - textTokens[i].text) : 0;
-        i++;
+        __m256i block = _mm256_loadu_si256((const __m256i*)string);
+        __m256i hits  = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, terminators),
+                                                        _mm256_cmpeq_epi8(block, comments)),
+                                                        _mm256_cmpeq_epi8(block, labels));
+
+        for (unsigned mask = (unsigned)_mm256_movemask_epi8(hits); mask; mask &= mask - 1)
+            _splitSymbol(state, string + __builtin_ctz(mask));
     }
 
-    return (const String*)textTokens;
+    return string;
+}
+
+#endif
+
+const char* _splitVectorized(SplitState* state, const char* string, const char* end)
+{
+#ifdef __SSE2__
+    if (__builtin_cpu_supports("avx2"))
+        return _splitAVX2(state, string, end);
+
+    return _splitSSE2(state, string, end);
+#else
+    (void)state;
+    (void)end;
+    return string;
+#endif
 }
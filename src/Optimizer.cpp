@@ -0,0 +1,1058 @@
+#include <string.h>
+#include <math.h>
+#include "Optimizer.hpp"
+#include "Sort.hpp"
+
+static const size_t NO_INSTRUCTION = (size_t)-1;
+static const size_t MAX_JUMP_HOPS  = 16;
+
+/** @struct CodeInstruction
+ * @brief Command of the code being optimized.
+ *
+ * @var CodeInstruction::instruction - the command.
+ * @var CodeInstruction::position - where the command was before optimizing.
+ * @var CodeInstruction::newPosition - where it is after, for removed commands where the next kept one is.
+ * @var CodeInstruction::fixup - fixup of the command's label immediate or NULL.
+ * @var CodeInstruction::labelIndex - label of the immediate.
+ * @var CodeInstruction::target - command the immediate points to, NO_INSTRUCTION if the label is not defined.
+ * @var CodeInstruction::redirect - command which replaces a removed one, NO_INSTRUCTION for the next one.
+ * @var CodeInstruction::referencesCount - number of labels and jumps which point to the command.
+ * @var CodeInstruction::isTarget - whether a label or a jump points to the command.
+ * @var CodeInstruction::isRemoved - whether the command is dropped.
+ */
+struct CodeInstruction
+{
+    Instruction  instruction;
+    size_t       position;
+    size_t       newPosition;
+    const Fixup* fixup;
+    size_t       labelIndex;
+    size_t       target;
+    size_t       redirect;
+    size_t       referencesCount;
+    bool         isTarget;
+    bool         isRemoved;
+};
+
+/** @struct CodeBlock
+ * @brief Basic block, commands from a label or a jump to the next jump.
+ *
+ * @var CodeBlock::first - index of the first command in the list of kept commands.
+ * @var CodeBlock::last - index of the last one.
+ * @var CodeBlock::run - run of blocks falling through into each other which the block belongs to.
+ * @var CodeBlock::isReachable - whether the block can be executed.
+ */
+struct CodeBlock
+{
+    size_t first;
+    size_t last;
+    size_t run;
+    bool   isReachable;
+};
+
+/** @struct ControlFlow
+ * @brief Control flow graph of the kept commands.
+ *
+ * @var ControlFlow::kept - kept commands in the order of the code.
+ * @var ControlFlow::keptCount - their number.
+ * @var ControlFlow::blockOf - block of every command.
+ * @var ControlFlow::blocks - the blocks.
+ * @var ControlFlow::blocksCount - their number.
+ * @var ControlFlow::runsFirst - first block of every run.
+ * @var ControlFlow::runsCount - number of runs.
+ * @var ControlFlow::lastRun - run which falls off the end of the code and must stay last, NO_INSTRUCTION if none.
+ */
+struct ControlFlow
+{
+    size_t*    kept;
+    size_t     keptCount;
+    size_t*    blockOf;
+    CodeBlock* blocks;
+    size_t     blocksCount;
+    size_t*    runsFirst;
+    size_t     runsCount;
+    size_t     lastRun;
+};
+
+/** @struct DecodedCode
+ * @brief Commands of the code and one more past them which stands for the end of the code.
+ *
+ * @var DecodedCode::instructions - the commands.
+ * @var DecodedCode::count - number of commands without the one past them.
+ * @var DecodedCode::capacity - size of instructions.
+ * @var DecodedCode::labelInstructions - command of every label, NO_INSTRUCTION for undefined labels.
+ * @var DecodedCode::labelsCount - number of labels.
+ */
+struct DecodedCode
+{
+    CodeInstruction* instructions;
+    size_t           count;
+    size_t           capacity;
+    size_t*          labelInstructions;
+    size_t           labelsCount;
+};
+
+static ErrorCode _loadCode(const AssemblerState* state, DecodedCode* code);
+
+static ErrorCode _findTargets(const AssemblerState* state, DecodedCode* code, bool* canOptimize);
+
+static size_t _findInstruction(const DecodedCode* code, size_t position);
+
+static size_t _keptInstruction(const DecodedCode* code, size_t index);
+
+static ErrorCode _peephole(DecodedCode* code);
+
+static void _threadJumps(DecodedCode* code);
+
+static void _countReferences(DecodedCode* code);
+
+static ErrorCode _layoutCode(DecodedCode* code, bool isObject, size_t** layout, size_t* layoutCount);
+
+static ErrorCode _buildControlFlow(const DecodedCode* code, ControlFlow* flow);
+
+static ErrorCode _markReachable(DecodedCode* code, ControlFlow* flow, bool isObject);
+
+static size_t _jumpBlock(const DecodedCode* code, const ControlFlow* flow, const CodeInstruction* jump);
+
+static ErrorCode _findRuns(const DecodedCode* code, ControlFlow* flow);
+
+static size_t _placeRuns(const DecodedCode* code, const ControlFlow* flow, bool* placed, size_t* layout);
+
+static void _removeJumpsToNext(DecodedCode* code, const size_t* layout, size_t layoutCount);
+
+static void _invertBranches(DecodedCode* code, const size_t* layout, size_t layoutCount);
+
+static size_t _nextInLayout(const DecodedCode* code, const size_t* layout, size_t layoutCount, size_t position);
+
+static void _destroyControlFlow(ControlFlow* flow);
+
+static void _fuseCommands(DecodedCode* code, const size_t* layout, size_t layoutCount);
+
+static const FusedCommand* _findFusedCommand(const CodeInstruction* first, const CodeInstruction* second);
+
+static ErrorCode _encodeCode(AssemblerState* state, DecodedCode* code, const size_t* layout, size_t layoutCount);
+
+static void _moveListing(AssemblerState* state, const DecodedCode* code);
+
+static int _compareListingLines(const void* a, const void* b);
+
+static bool _isJump(byte command);
+
+static bool _endsBlock(byte command);
+
+static bool _isTerminator(byte command);
+
+static bool _isConstantPush(const CodeInstruction* instruction);
+
+static bool _isSameOperand(const Instruction* a, const Instruction* b);
+
+static bool _foldBinary(byte command, double a, double b, double* result);
+
+static bool _foldUnary(byte command, double a, double* result);
+
+static void _setConstant(CodeInstruction* push, double value);
+
+static bool _canPushConstant(double value);
+
+ErrorCode OptimizeCode(AssemblerState* state, bool isObject, bool fuse)
+{
+    MyAssertSoft(state, ERROR_NULLPTR);
+    MyAssertSoft(state->collectIr, ERROR_BAD_VALUE);
+
+    DecodedCode code        = {};
+    bool        canOptimize = true;
+    size_t*     layout      = NULL;
+    size_t      layoutCount = 0;
+
+    ErrorCode error = _loadCode(state, &code);
+
+    if (!error && canOptimize)
+        error = _findTargets(state, &code, &canOptimize);
+
+    if (!error && canOptimize)
+        error = _peephole(&code);
+
+    if (!error && canOptimize)
+    {
+        _threadJumps(&code);
+        error = _layoutCode(&code, isObject, &layout, &layoutCount);
+    }
+
+    if (!error && canOptimize && fuse)
+        _fuseCommands(&code, layout, layoutCount);
+
+    if (!error && canOptimize)
+        error = _encodeCode(state, &code, layout, layoutCount);
+
+    free(layout);
+    free(code.instructions);
+    free(code.labelInstructions);
+
+    return error;
+}
+
+static ErrorCode _loadCode(const AssemblerState* state, DecodedCode* code)
+{
+    const CodeIr* ir       = &state->ir;
+    size_t        codeSize = state->codePosition;
+
+    RETURN_ERROR(GrowArray((void**)&code->instructions, &code->capacity, ir->count + 1,
+                           sizeof(*code->instructions)));
+
+    size_t position = 0;
+
+    for (size_t i = 0; i < ir->count; i++)
+    {
+        CodeInstruction* instruction = &code->instructions[i];
+        *instruction = {};
+
+        instruction->instruction = {ir->commands[i], ir->argTypes[i], ir->regNums[i], ir->immeds[i],
+                                    (ImmediateWidth)ir->widths[i], ir->sizes[i]};
+        instruction->position    = position;
+        instruction->labelIndex  = NO_INSTRUCTION;
+        instruction->target      = NO_INSTRUCTION;
+        instruction->redirect    = NO_INSTRUCTION;
+
+        position += ir->sizes[i];
+    }
+
+    code->count = ir->count;
+
+    // the end of the code is a command which is never removed, so labels and jumps past the last command work
+    CodeInstruction* end = &code->instructions[code->count];
+    *end = {};
+
+    end->position   = codeSize;
+    end->labelIndex = NO_INSTRUCTION;
+    end->target     = NO_INSTRUCTION;
+    end->redirect   = NO_INSTRUCTION;
+    end->isTarget   = true;
+
+    return EVERYTHING_FINE;
+}
+
+static ErrorCode _findTargets(const AssemblerState* state, DecodedCode* code, bool* canOptimize)
+{
+    // fixups are in the order of the commands, so they are taken one after another
+    size_t nextFixup = 0;
+
+    for (size_t i = 0; i < code->count; i++)
+    {
+        size_t fixupsCount = state->ir.fixupsCounts[i];
+        if (fixupsCount == 0)
+            continue;
+
+        CodeInstruction* instruction = &code->instructions[i];
+        const Fixup*     fixup       = &state->fixups[nextFixup];
+
+        nextFixup += fixupsCount;
+
+        // labels used as data or in addresses keep their meaning only if the code doesn't move
+        if (!_isJump(instruction->instruction.command) || instruction->instruction.argType != ImmediateNumberArg ||
+            fixupsCount > 1)
+        {
+            *canOptimize = false;
+            return EVERYTHING_FINE;
+        }
+
+        instruction->fixup      = fixup;
+        instruction->labelIndex = fixup->labelIndex;
+    }
+
+    code->labelInstructions = (size_t*)calloc(state->labels.size + 1, sizeof(*code->labelInstructions));
+    MyAssertSoft(code->labelInstructions, ERROR_NO_MEMORY);
+
+    code->labelsCount = state->labels.size;
+
+    for (size_t i = 0; i < state->labels.size; i++)
+    {
+        const Label* label = &state->labels.labels[i];
+
+        code->labelInstructions[i] = NO_INSTRUCTION;
+        if (!label->isDefined)
+            continue;
+
+        size_t index = _findInstruction(code, (size_t)label->codePosition);
+        if (code->instructions[index].position != label->codePosition)
+        {
+            *canOptimize = false;
+            return EVERYTHING_FINE;
+        }
+
+        code->labelInstructions[i]         = index;
+        code->instructions[index].isTarget = true;
+    }
+
+    for (size_t i = 0; i < code->count; i++)
+    {
+        CodeInstruction* instruction = &code->instructions[i];
+
+        if (!_isJump(instruction->instruction.command))
+            continue;
+
+        // jumps by numbers, registers or RAM can land anywhere
+        if (!instruction->fixup)
+        {
+            *canOptimize = false;
+            return EVERYTHING_FINE;
+        }
+
+        size_t labelInstruction = code->labelInstructions[instruction->labelIndex];
+        if (labelInstruction == NO_INSTRUCTION)
+            continue;
+
+        // the immediate is in units of addresses, positions here are in bytes
+        double unitSize = (double)CodeUnitSize(state->format);
+        double target   = state->labels.labels[instruction->labelIndex].codePosition +
+                          instruction->instruction.immed * unitSize;
+        size_t index  = 0 <= target && target <= (double)state->codePosition ?
+                        _findInstruction(code, (size_t)target) : NO_INSTRUCTION;
+
+        if (index == NO_INSTRUCTION || code->instructions[index].position != target)
+        {
+            *canOptimize = false;
+            return EVERYTHING_FINE;
+        }
+
+        instruction->target                = index;
+        code->instructions[index].isTarget = true;
+    }
+
+    return EVERYTHING_FINE;
+}
+
+static size_t _findInstruction(const DecodedCode* code, size_t position)
+{
+    size_t left  = 0;
+    size_t right = code->count + 1;
+
+    // the last command which starts at the position or before it
+    while (right - left > 1)
+    {
+        size_t middle = left + (right - left) / 2;
+
+        if (code->instructions[middle].position <= position)
+            left = middle;
+        else
+            right = middle;
+    }
+
+    return left;
+}
+
+static size_t _keptInstruction(const DecodedCode* code, size_t index)
+{
+    while (code->instructions[index].isRemoved)
+    {
+        const CodeInstruction* removed = &code->instructions[index];
+
+        index = removed->redirect != NO_INSTRUCTION ? removed->redirect : index + 1;
+    }
+
+    return index;
+}
+
+static ErrorCode _peephole(DecodedCode* code)
+{
+    // kept commands work like a stack, so folded pushes can be folded again with the next command
+    size_t* kept = (size_t*)calloc(code->count + 1, sizeof(*kept));
+    MyAssertSoft(kept, ERROR_NO_MEMORY);
+
+    size_t keptCount   = 0;
+    bool   carryTarget = false;
+
+    for (size_t i = 0; i < code->count; i++)
+    {
+        CodeInstruction* cur = &code->instructions[i];
+
+        // a removed target passes its label on, so nothing before it joins commands after it
+        if (carryTarget)
+        {
+            cur->isTarget = true;
+            carryTarget   = false;
+        }
+
+        CodeInstruction* last       = keptCount >= 1 ? &code->instructions[kept[keptCount - 1]] : NULL;
+        CodeInstruction* beforeLast = keptCount >= 2 ? &code->instructions[kept[keptCount - 2]] : NULL;
+
+        byte   command = cur->instruction.command;
+        double folded  = 0;
+
+        if (!cur->isTarget && last && _isConstantPush(last))
+        {
+            if (beforeLast && !last->isTarget && _isConstantPush(beforeLast) &&
+                _foldBinary(command, beforeLast->instruction.immed, last->instruction.immed, &folded) &&
+                _canPushConstant(folded))
+            {
+                _setConstant(beforeLast, folded);
+
+                last->isRemoved = true;
+                cur->isRemoved  = true;
+                keptCount--;
+                continue;
+            }
+
+            if (_foldUnary(command, last->instruction.immed, &folded) && _canPushConstant(folded))
+            {
+                _setConstant(last, folded);
+
+                cur->isRemoved = true;
+                continue;
+            }
+        }
+
+        if (!cur->isTarget && last && command == CMD_POP && last->instruction.command == CMD_PUSH &&
+            _isSameOperand(&last->instruction, &cur->instruction))
+        {
+            carryTarget = last->isTarget;
+
+            last->isRemoved = true;
+            cur->isRemoved  = true;
+            keptCount--;
+            continue;
+        }
+
+        // the callee returns straight to our caller
+        if (command == CMD_RET && last && last->instruction.command == CMD_CALL)
+        {
+            last->instruction.command = CMD_JMP;
+
+            if (!cur->isTarget)
+            {
+                cur->isRemoved = true;
+                continue;
+            }
+        }
+
+        kept[keptCount++] = i;
+    }
+
+    free(kept);
+
+    return EVERYTHING_FINE;
+}
+
+static void _threadJumps(DecodedCode* code)
+{
+    for (size_t i = 0; i < code->count; i++)
+    {
+        CodeInstruction* cur = &code->instructions[i];
+
+        if (cur->isRemoved || !_isJump(cur->instruction.command) || cur->target == NO_INSTRUCTION)
+            continue;
+
+        for (size_t hop = 0; hop < MAX_JUMP_HOPS; hop++)
+        {
+            size_t target = _keptInstruction(code, cur->target);
+            const CodeInstruction* next = &code->instructions[target];
+
+            if (target == code->count || target == i || next->instruction.command != CMD_JMP ||
+                next->target == NO_INSTRUCTION)
+                break;
+
+            cur->labelIndex = next->labelIndex;
+            cur->target     = next->target;
+        }
+    }
+}
+
+static void _countReferences(DecodedCode* code)
+{
+    for (size_t i = 0; i <= code->count; i++)
+        code->instructions[i].referencesCount = 0;
+
+    for (size_t i = 0; i < code->count; i++)
+    {
+        const CodeInstruction* instruction = &code->instructions[i];
+
+        if (!instruction->isRemoved && instruction->target != NO_INSTRUCTION)
+            code->instructions[_keptInstruction(code, instruction->target)].referencesCount++;
+    }
+
+    // labels are exported from objects, so they count even if no jump uses them
+    for (size_t i = 0; i < code->labelsCount; i++)
+        if (code->labelInstructions[i] != NO_INSTRUCTION)
+            code->instructions[_keptInstruction(code, code->labelInstructions[i])].referencesCount++;
+}
+
+static ErrorCode _layoutCode(DecodedCode* code, bool isObject, size_t** layout, size_t* layoutCount)
+{
+    ControlFlow flow = {};
+
+    _countReferences(code);
+
+    ErrorCode error = _buildControlFlow(code, &flow);
+
+    if (!error)
+        error = _markReachable(code, &flow, isObject);
+
+    bool* placed = NULL;
+    if (!error)
+        error = _findRuns(code, &flow);
+
+    if (!error)
+    {
+        placed  = (bool*)  calloc(flow.runsCount + 1, sizeof(*placed));
+        *layout = (size_t*)calloc(flow.keptCount + 1, sizeof(**layout));
+
+        if (!placed || !*layout)
+            error = ERROR_NO_MEMORY;
+    }
+
+    if (!error)
+    {
+        *layoutCount = _placeRuns(code, &flow, placed, *layout);
+
+        _removeJumpsToNext(code, *layout, *layoutCount);
+        _invertBranches   (code, *layout, *layoutCount);
+    }
+
+    free(placed);
+    _destroyControlFlow(&flow);
+
+    return error;
+}
+
+static ErrorCode _buildControlFlow(const DecodedCode* code, ControlFlow* flow)
+{
+    flow->kept    = (size_t*)   calloc(code->count + 1, sizeof(*flow->kept));
+    flow->blockOf = (size_t*)   calloc(code->count + 1, sizeof(*flow->blockOf));
+    flow->blocks  = (CodeBlock*)calloc(code->count + 1, sizeof(*flow->blocks));
+    MyAssertSoft(flow->kept && flow->blockOf && flow->blocks, ERROR_NO_MEMORY);
+
+    for (size_t i = 0; i < code->count; i++)
+    {
+        const CodeInstruction* instruction = &code->instructions[i];
+        if (instruction->isRemoved)
+            continue;
+
+        size_t keptIndex = flow->keptCount++;
+        flow->kept[keptIndex] = i;
+
+        // blocks start at targets and after jumps, calls, returns and halts
+        bool isLeader = keptIndex == 0 || instruction->referencesCount > 0 ||
+                        _endsBlock(code->instructions[flow->kept[keptIndex - 1]].instruction.command);
+
+        if (isLeader)
+            flow->blocks[flow->blocksCount++].first = keptIndex;
+
+        flow->blocks[flow->blocksCount - 1].last = keptIndex;
+        flow->blockOf[i] = flow->blocksCount - 1;
+    }
+
+    flow->blockOf[code->count] = NO_INSTRUCTION;
+
+    return EVERYTHING_FINE;
+}
+
+static ErrorCode _markReachable(DecodedCode* code, ControlFlow* flow, bool isObject)
+{
+    if (flow->blocksCount == 0)
+        return EVERYTHING_FINE;
+
+    size_t* stack      = (size_t*)calloc(2 * flow->blocksCount + 1, sizeof(*stack));
+    size_t  stackCount = 0;
+    MyAssertSoft(stack, ERROR_NO_MEMORY);
+
+    flow->blocks[0].isReachable = true;
+    stack[stackCount++] = 0;
+
+    // other modules may jump to any label of an object
+    for (size_t i = 0; isObject && i < code->labelsCount; i++)
+    {
+        if (code->labelInstructions[i] == NO_INSTRUCTION)
+            continue;
+
+        size_t block = flow->blockOf[_keptInstruction(code, code->labelInstructions[i])];
+
+        if (block != NO_INSTRUCTION && !flow->blocks[block].isReachable)
+        {
+            flow->blocks[block].isReachable = true;
+            stack[stackCount++] = block;
+        }
+    }
+
+    while (stackCount > 0)
+    {
+        size_t block = stack[--stackCount];
+        const CodeInstruction* last = &code->instructions[flow->kept[flow->blocks[block].last]];
+
+        size_t successors[2] = {NO_INSTRUCTION, _jumpBlock(code, flow, last)};
+
+        if (!_isTerminator(last->instruction.command) && block + 1 < flow->blocksCount)
+            successors[0] = block + 1;
+
+        for (size_t i = 0; i < 2; i++)
+        {
+            if (successors[i] != NO_INSTRUCTION && !flow->blocks[successors[i]].isReachable)
+            {
+                flow->blocks[successors[i]].isReachable = true;
+                stack[stackCount++] = successors[i];
+            }
+        }
+    }
+
+    free(stack);
+
+    for (size_t block = 0; block < flow->blocksCount; block++)
+    {
+        if (flow->blocks[block].isReachable)
+            continue;
+
+        for (size_t k = flow->blocks[block].first; k <= flow->blocks[block].last; k++)
+            code->instructions[flow->kept[k]].isRemoved = true;
+    }
+
+    return EVERYTHING_FINE;
+}
+
+static size_t _jumpBlock(const DecodedCode* code, const ControlFlow* flow, const CodeInstruction* jump)
+{
+    if (!_isJump(jump->instruction.command) || jump->target == NO_INSTRUCTION)
+        return NO_INSTRUCTION;
+
+    return flow->blockOf[_keptInstruction(code, jump->target)];
+}
+
+static ErrorCode _findRuns(const DecodedCode* code, ControlFlow* flow)
+{
+    flow->runsFirst = (size_t*)calloc(flow->blocksCount + 1, sizeof(*flow->runsFirst));
+    flow->lastRun   = NO_INSTRUCTION;
+    MyAssertSoft(flow->runsFirst, ERROR_NO_MEMORY);
+
+    // blocks which fall through into each other can only move together
+    for (size_t block = 0; block < flow->blocksCount; block++)
+    {
+        CodeBlock* cur = &flow->blocks[block];
+        if (!cur->isReachable)
+            continue;
+
+        const CodeInstruction* previous = block > 0 ?
+            &code->instructions[flow->kept[flow->blocks[block - 1].last]] : NULL;
+
+        if (!previous || !flow->blocks[block - 1].isReachable || _isTerminator(previous->instruction.command))
+            flow->runsFirst[flow->runsCount++] = block;
+
+        cur->run = flow->runsCount - 1;
+    }
+
+    if (flow->blocksCount > 0)
+    {
+        const CodeBlock*       last        = &flow->blocks[flow->blocksCount - 1];
+        const CodeInstruction* instruction = &code->instructions[flow->kept[last->last]];
+
+        if (last->isReachable && !_isTerminator(instruction->instruction.command))
+            flow->lastRun = last->run;
+    }
+
+    return EVERYTHING_FINE;
+}
+
+static size_t _placeRuns(const DecodedCode* code, const ControlFlow* flow, bool* placed, size_t* layout)
+{
+    size_t layoutCount = 0;
+    size_t firstFree   = 0;
+
+    // the entry stays first, then every run is followed by the run its final jmp goes to if it is free
+    for (size_t run = 0; run != NO_INSTRUCTION && flow->runsCount > 0; )
+    {
+        placed[run] = true;
+
+        size_t lastBlock = run + 1 < flow->runsCount ? flow->runsFirst[run + 1] : flow->blocksCount;
+        for (size_t block = flow->runsFirst[run]; block < lastBlock; block++)
+        {
+            if (!flow->blocks[block].isReachable)
+                continue;
+
+            for (size_t k = flow->blocks[block].first; k <= flow->blocks[block].last; k++)
+                layout[layoutCount++] = flow->kept[k];
+        }
+
+        const CodeInstruction* last = &code->instructions[layout[layoutCount - 1]];
+
+        size_t next        = NO_INSTRUCTION;
+        size_t targetBlock = last->instruction.command == CMD_JMP ? _jumpBlock(code, flow, last) : NO_INSTRUCTION;
+
+        if (targetBlock != NO_INSTRUCTION)
+        {
+            size_t targetRun = flow->blocks[targetBlock].run;
+
+            if (flow->runsFirst[targetRun] == targetBlock && !placed[targetRun] && targetRun != flow->lastRun)
+                next = targetRun;
+        }
+
+        while (next == NO_INSTRUCTION && firstFree < flow->runsCount)
+        {
+            if (!placed[firstFree] && firstFree != flow->lastRun)
+                next = firstFree;
+            else
+                firstFree++;
+        }
+
+        if (next == NO_INSTRUCTION && flow->lastRun != NO_INSTRUCTION && !placed[flow->lastRun])
+            next = flow->lastRun;
+
+        run = next;
+    }
+
+    return layoutCount;
+}
+
+static void _removeJumpsToNext(DecodedCode* code, const size_t* layout, size_t layoutCount)
+{
+    // backwards, so a jump over jumps which are removed is seen as a jump to the next command too
+    for (size_t position = layoutCount; position-- > 0; )
+    {
+        CodeInstruction* cur = &code->instructions[layout[position]];
+
+        if (cur->instruction.command != CMD_JMP || cur->target == NO_INSTRUCTION)
+            continue;
+
+        if (_keptInstruction(code, cur->target) == _nextInLayout(code, layout, layoutCount, position))
+        {
+            cur->isRemoved = true;
+            cur->redirect  = cur->target;
+        }
+    }
+}
+
+static void _invertBranches(DecodedCode* code, const size_t* layout, size_t layoutCount)
+{
+    // "je a / jmp b / a:" becomes "jne b / a:", only je and jne are exact opposites of each other
+    for (size_t position = 0; position < layoutCount; position++)
+    {
+        CodeInstruction* branch = &code->instructions[layout[position]];
+
+        byte command = branch->instruction.command;
+        if (branch->isRemoved || (command != CMD_JE && command != CMD_JNE) || branch->target == NO_INSTRUCTION)
+            continue;
+
+        size_t jumpPosition = position + 1;
+        while (jumpPosition < layoutCount && code->instructions[layout[jumpPosition]].isRemoved)
+            jumpPosition++;
+
+        if (jumpPosition == layoutCount)
+            continue;
+
+        CodeInstruction* jump = &code->instructions[layout[jumpPosition]];
+
+        if (jump->instruction.command != CMD_JMP || jump->target == NO_INSTRUCTION || jump->referencesCount > 0 ||
+            _keptInstruction(code, branch->target) != _nextInLayout(code, layout, layoutCount, jumpPosition))
+            continue;
+
+        branch->instruction.command = command == CMD_JE ? CMD_JNE : CMD_JE;
+        branch->labelIndex          = jump->labelIndex;
+        branch->target              = jump->target;
+
+        jump->isRemoved = true;
+        jump->redirect  = jump->target;
+    }
+}
+
+static size_t _nextInLayout(const DecodedCode* code, const size_t* layout, size_t layoutCount, size_t position)
+{
+    for (position++; position < layoutCount; position++)
+        if (!code->instructions[layout[position]].isRemoved)
+            return layout[position];
+
+    return code->count;
+}
+
+static void _destroyControlFlow(ControlFlow* flow)
+{
+    free(flow->kept);
+    free(flow->blockOf);
+    free(flow->blocks);
+    free(flow->runsFirst);
+
+    *flow = {};
+}
+
+static void _fuseCommands(DecodedCode* code, const size_t* layout, size_t layoutCount)
+{
+    // removed jumps and blocks pass their labels on, so targets are counted again
+    _countReferences(code);
+
+    for (size_t position = 0; position < layoutCount; position++)
+    {
+        CodeInstruction* first = &code->instructions[layout[position]];
+        if (first->isRemoved)
+            continue;
+
+        size_t secondIndex = _nextInLayout(code, layout, layoutCount, position);
+        if (secondIndex == code->count)
+            break;
+
+        CodeInstruction*    second = &code->instructions[secondIndex];
+        const FusedCommand* fused  = _findFusedCommand(first, second);
+
+        // nothing may jump between the commands
+        if (!fused || second->referencesCount > 0)
+            continue;
+
+        if (fused->fusedArg == FUSED_FIRST_ARG)
+        {
+            first->instruction.command = (byte)fused->command;
+
+            second->isRemoved = true;
+            second->redirect  = layout[position];
+        }
+        else
+        {
+            second->instruction.command = (byte)fused->command;
+
+            first->isRemoved = true;
+            first->redirect  = secondIndex;
+        }
+    }
+}
+
+static const FusedCommand* _findFusedCommand(const CodeInstruction* first, const CodeInstruction* second)
+{
+    const Instruction* a = &first->instruction;
+    const Instruction* b = &second->instruction;
+
+    for (size_t i = 0; i < FUSED_COMMANDS_COUNT; i++)
+    {
+        const FusedCommand* fused = &FUSED_COMMANDS[i];
+
+        if (a->command != fused->first || b->command != fused->second)
+            continue;
+
+        bool argFits = fused->fusedArg == FUSED_FIRST_ARG ?
+                       b->argType == 0 :
+                       a->argType == ImmediateNumberArg && a->immed == 0;
+
+        if (argFits)
+            return fused;
+    }
+
+    return NULL;
+}
+
+static ErrorCode _encodeCode(AssemblerState* state, DecodedCode* code, const size_t* layout, size_t layoutCount)
+{
+    // label immediates keep their widths, so sizes of commands don't depend on where labels move
+    byte   scratch[MAX_INSTRUCTION_SIZE] = {};
+    size_t codeSize = 0;
+
+    for (size_t position = 0; position < layoutCount; position++)
+    {
+        CodeInstruction* instruction = &code->instructions[layout[position]];
+        if (instruction->isRemoved)
+            continue;
+
+        instruction->newPosition = codeSize;
+        codeSize += EncodeInstruction(scratch, &instruction->instruction, state->format, NULL);
+    }
+
+    code->instructions[code->count].newPosition = codeSize;
+
+    byte*  newCode         = NULL;
+    size_t newCodeCapacity = 0;
+    RETURN_ERROR(GrowArray((void**)&newCode, &newCodeCapacity, codeSize + 1, sizeof(*newCode)));
+
+    Fixup* newFixups         = NULL;
+    size_t newFixupsCapacity = 0;
+    size_t newFixupsCount    = 0;
+    ErrorCode error = GrowArray((void**)&newFixups, &newFixupsCapacity, state->fixupsCount + 1, sizeof(*newFixups));
+    MyAssertSoft(!error, error, free(newCode));
+
+    // the kept commands replace the IR in their new order
+    state->ir.count = 0;
+
+    for (size_t position = 0; position < layoutCount; position++)
+    {
+        const CodeInstruction* cur = &code->instructions[layout[position]];
+        if (cur->isRemoved)
+            continue;
+
+        Instruction instruction = cur->instruction;
+
+        // the immediate is an offset from the label which is added when the label is resolved
+        if (cur->target != NO_INSTRUCTION)
+        {
+            size_t labelInstruction = code->labelInstructions[cur->labelIndex];
+
+            instruction.immed = ((double)code->instructions[_keptInstruction(code, cur->target)].newPosition -
+                                 (double)code->instructions[_keptInstruction(code, labelInstruction)].newPosition) /
+                                (double)CodeUnitSize(state->format);
+        }
+
+        size_t immedOffset = 0;
+        instruction.size = EncodeInstruction(newCode + cur->newPosition, &instruction, state->format, &immedOffset);
+
+        error = CodeIrAppend(&state->ir, &instruction, cur->fixup ? 1 : 0);
+        MyAssertSoft(!error, error, free(newCode); free(newFixups));
+
+        if (cur->fixup)
+        {
+            Fixup* fixup = &newFixups[newFixupsCount++];
+
+            *fixup = *cur->fixup;
+            fixup->codePosition = cur->newPosition + immedOffset;
+            fixup->labelIndex   = cur->labelIndex;
+        }
+    }
+
+    for (size_t i = 0; i < state->labels.size; i++)
+    {
+        size_t labelInstruction = code->labelInstructions[i];
+
+        if (labelInstruction != NO_INSTRUCTION)
+            state->labels.labels[i].codePosition =
+                (double)code->instructions[_keptInstruction(code, labelInstruction)].newPosition;
+    }
+
+    _moveListing(state, code);
+
+    free(state->codeArray);
+    state->codeArray    = newCode;
+    state->codeCapacity = newCodeCapacity;
+    state->codePosition = codeSize;
+
+    free(state->fixups);
+    state->fixups         = newFixups;
+    state->fixupsCapacity = newFixupsCapacity;
+    state->fixupsCount    = newFixupsCount;
+
+    return EVERYTHING_FINE;
+}
+
+static void _moveListing(AssemblerState* state, const DecodedCode* code)
+{
+    size_t keptCount = 0;
+
+    for (size_t i = 0; i < state->listingCount; i++)
+    {
+        ListingLine line = state->listing[i];
+
+        size_t index = _findInstruction(code, line.codePosition);
+        const CodeInstruction* instruction = &code->instructions[index];
+
+        // lines of removed commands go away, labels move to the command which replaces theirs
+        if (line.commandInfo)
+        {
+            if (instruction->isRemoved)
+                continue;
+
+            line.commandInfo = FindCommandByNumber(instruction->instruction.command);
+        }
+        else
+            instruction = &code->instructions[_keptInstruction(code, index)];
+
+        line.codePosition = instruction->newPosition;
+
+        state->listing[keptCount++] = line;
+    }
+
+    state->listingCount = keptCount;
+
+    // blocks may be laid out in another order than in the source, the listing follows the code
+    if (state->listingCount)
+        Sort(state->listing, state->listingCount, sizeof(*state->listing), _compareListingLines);
+}
+
+static int _compareListingLines(const void* a, const void* b)
+{
+    const ListingLine* lineA = (const ListingLine*)a;
+    const ListingLine* lineB = (const ListingLine*)b;
+
+    if (lineA->codePosition != lineB->codePosition)
+        return lineA->codePosition < lineB->codePosition ? -1 : 1;
+
+    // labels go ahead of the command they are at, then lines keep the source order
+    if ((lineA->commandInfo != NULL) != (lineB->commandInfo != NULL))
+        return lineA->commandInfo ? 1 : -1;
+
+    if (lineA->tokenIndex != lineB->tokenIndex)
+        return lineA->tokenIndex < lineB->tokenIndex ? -1 : 1;
+
+    return 0;
+}
+
+static bool _isJump(byte command)
+{
+    switch (command)
+    {
+        case CMD_JMP:
+        case CMD_JA:
+        case CMD_JAE:
+        case CMD_JB:
+        case CMD_JBE:
+        case CMD_JE:
+        case CMD_JNE:
+        case CMD_JF:
+        case CMD_CALL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool _endsBlock(byte command)
+{
+    return _isJump(command) || command == CMD_RET || command == CMD_HLT;
+}
+
+static bool _isTerminator(byte command)
+{
+    // control never goes on to the next command
+    return command == CMD_JMP || command == CMD_RET || command == CMD_HLT;
+}
+
+static bool _isConstantPush(const CodeInstruction* instruction)
+{
+    return instruction->instruction.command == CMD_PUSH && instruction->instruction.argType == ImmediateNumberArg;
+}
+
+static bool _isSameOperand(const Instruction* a, const Instruction* b)
+{
+    // pop writes only to a register or a RAM cell, "pop rax+1" is an error the pair must keep
+    if (a->argType != b->argType || (a->argType != RegisterArg && !(a->argType & RAMArg)))
+        return false;
+
+    if ((a->argType & RegisterArg) && a->regNum != b->regNum)
+        return false;
+
+    if ((a->argType & ImmediateNumberArg) && memcmp(&a->immed, &b->immed, sizeof(a->immed)) != 0)
+        return false;
+
+    return true;
+}
+
+static bool _foldBinary(byte command, double a, double b, double* result)
+{
+    switch (command)
+    {
+        case CMD_ADD: *result = a + b; return true;
+        case CMD_SUB: *result = a - b; return true;
+        case CMD_MUL: *result = a * b; return true;
+        case CMD_DIV: *result = a / b; return true;
+        default:      return false;
+    }
+}
+
+static bool _foldUnary(byte command, double a, double* result)
+{
+    // sin and cos are not folded, they may differ between the assembler's and the SPU's libm
+    switch (command)
+    {
+        case CMD_SQRT: *result = sqrt (a); return true;
+        case CMD_FLR:  *result = floor(a); return true;
+        case CMD_CEIL: *result = ceil (a); return true;
+        default:       return false;
+    }
+}
+
+static void _setConstant(CodeInstruction* push, double value)
+{
+    push->instruction.immed = value;
+    push->instruction.width = ChooseImmediateWidth(value, false);
+}
+
+static bool _canPushConstant(double value)
+{
+    // an argument may be summed up from 0 by the SPU, which turns a pushed -0.0 into 0.0 unlike a computed one
+    return !(value == 0 && signbit(value));
+}
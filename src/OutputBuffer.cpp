@@ -0,0 +1,153 @@
+#include <string.h>
+#include <stdarg.h>
+#include "OutputBuffer.hpp"
+
+static const char   HEX_DIGITS[]         = "0123456789ABCDEF";
+static const size_t MAX_DECIMAL_LENGTH   = 20;
+
+ErrorCode OutputBufferInit(OutputBuffer* buffer, FILE* file, size_t capacity)
+{
+    MyAssertSoft(buffer, ERROR_NULLPTR);
+    MyAssertSoft(file, ERROR_NULLPTR);
+
+    *buffer = {};
+
+    buffer->data = (char*)malloc(capacity);
+    MyAssertSoft(buffer->data, ERROR_NO_MEMORY);
+
+    buffer->file     = file;
+    buffer->capacity = capacity;
+
+    return EVERYTHING_FINE;
+}
+
+ErrorCode OutputBufferDestroy(OutputBuffer* buffer)
+{
+    MyAssertSoft(buffer, ERROR_NULLPTR);
+
+    ErrorCode error = OutputBufferFlush(buffer);
+
+    free(buffer->data);
+    *buffer = {};
+
+    return error;
+}
+
+ErrorCode OutputBufferFlush(OutputBuffer* buffer)
+{
+    MyAssertSoft(buffer, ERROR_NULLPTR);
+
+    if (!buffer->error && buffer->size &&
+        fwrite(buffer->data, sizeof(*buffer->data), buffer->size, buffer->file) != buffer->size)
+        buffer->error = ERROR_BAD_FILE;
+
+    buffer->size = 0;
+
+    return buffer->error;
+}
+
+char* OutputBufferReserve(OutputBuffer* buffer, size_t size)
+{
+    MyAssertHard(buffer, ERROR_NULLPTR);
+
+    if (buffer->capacity - buffer->size >= size)
+        return buffer->data + buffer->size;
+
+    if (OutputBufferFlush(buffer))
+        return NULL;
+
+    if (buffer->capacity < size)
+    {
+        char* newData = (char*)realloc(buffer->data, size);
+        if (!newData)
+        {
+            buffer->error = ERROR_NO_MEMORY;
+            return NULL;
+        }
+
+        buffer->data     = newData;
+        buffer->capacity = size;
+    }
+
+    return buffer->data;
+}
+
+void OutputBufferCommit(OutputBuffer* buffer, const char* end)
+{
+    MyAssertHard(buffer, ERROR_NULLPTR, );
+
+    buffer->size = (size_t)(end - buffer->data);
+}
+
+void OutputBufferWrite(OutputBuffer* buffer, const char* data, size_t size)
+{
+    char* where = OutputBufferReserve(buffer, size);
+    if (!where)
+        return;
+
+    memcpy(where, data, size);
+    OutputBufferCommit(buffer, where + size);
+}
+
+void OutputBufferPrintf(OutputBuffer* buffer, const char* format, ...)
+{
+    MyAssertHard(buffer, ERROR_NULLPTR, );
+    MyAssertHard(format, ERROR_NULLPTR, );
+
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    if (length < 0)
+    {
+        buffer->error = ERROR_BAD_VALUE;
+        return;
+    }
+
+    // vsnprintf needs room for the terminator which is not committed
+    char* where = OutputBufferReserve(buffer, (size_t)length + 1);
+    if (!where)
+        return;
+
+    va_start(args, format);
+    vsnprintf(where, (size_t)length + 1, format, args);
+    va_end(args);
+
+    OutputBufferCommit(buffer, where + length);
+}
+
+char* FormatHex(char* where, uint64_t value, size_t digits)
+{
+    for (size_t i = digits; i > 0; i--)
+    {
+        where[i - 1] = HEX_DIGITS[value & 0xF];
+        value >>= 4;
+    }
+
+    return where + digits;
+}
+
+char* FormatDecimal(char* where, uint64_t value)
+{
+    char digits[MAX_DECIMAL_LENGTH] = "";
+    size_t length = 0;
+
+    do
+    {
+        digits[MAX_DECIMAL_LENGTH - ++length] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    memcpy(where, digits + MAX_DECIMAL_LENGTH - length, length);
+
+    return where + length;
+}
+
+char* FormatSpaces(char* where, size_t count)
+{
+    memset(where, ' ', count);
+
+    return where + count;
+}
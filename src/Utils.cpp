@@ -43,7 +43,7 @@ bool CheckInput(FILE* where)
 
 void SetConsoleColor(FILE* where, enum Color color)
 {
-	fprintf(where, "\033[0;%dm", (int)color);
+	fprintf(where, CONSOLE_COLOR_FORMAT, (int)color);
 }
 
 size_t GetFileSize(const char* path)
@@ -71,7 +71,7 @@ unsigned int CalculateHash(const void *key, size_t len, unsigned int seed)
 
 	while(len >= 4)
 	{
-		k = *(unsigned int*)data;
+		memcpy(&k, data, sizeof(k));
 
 		mmix(h,k);
 
@@ -105,3 +105,50 @@ unsigned int CalculateHash(const void *key, size_t len, unsigned int seed)
 
 	return h;
 }
+
+uint64_t CalculateHash64(const void *key, size_t len, uint64_t seed)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+
+	const unsigned char* data = (const unsigned char *)key;
+	const unsigned char* end  = data + (len / 8) * 8;
+
+	uint64_t h = seed ^ (len * m);
+
+	while (data != end)
+	{
+		uint64_t k;
+		memcpy(&k, data, sizeof(k));
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+
+		data += 8;
+	}
+
+	switch (len & 7)
+	{
+	case 7: h ^= (uint64_t)data[6] << 48; [[fallthrough]];
+	case 6: h ^= (uint64_t)data[5] << 40; [[fallthrough]];
+	case 5: h ^= (uint64_t)data[4] << 32; [[fallthrough]];
+	case 4: h ^= (uint64_t)data[3] << 24; [[fallthrough]];
+	case 3: h ^= (uint64_t)data[2] << 16; [[fallthrough]];
+	case 2: h ^= (uint64_t)data[1] << 8;  [[fallthrough]];
+	case 1: h ^= (uint64_t)data[0];
+	        h *= m;
+	        break;
+	default:
+		break;
+	};
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
@@ -1,23 +1,151 @@
 #include <string.h>
+#include <unistd.h>
 #include "Assembler.hpp"
+#include "Batch.hpp"
+#include "Linker.hpp"
 #include "Utils.hpp"
 
+static const char USAGE[] = "Usage: DugongAssembler [--stream] [--compact | --aligned] [--jobs[=N]] [--cache] "
+                            "[--object] [--optimize] [--fuse] [--container] [--no-listing] [--stats=json] input output\n"
+                            "       DugongAssembler [options] --batch=manifest\n"
+                            "       DugongAssembler [--container] --link output object...\n";
+
+static ErrorCode _compileFile(const char* codeFilePath, const char* byteCodeFilePath, const CompileOptions* options,
+                              bool writeListing);
+
 int main(int argc, const char* const argv[])
 {
-    if (argc != 3)
+    CompileOptions options = {};
+    bool writeListing = true;
+    bool link = false;
+    CompileStats stats = {};
+    const char* manifestPath = NULL;
+
+    const char** files = (const char**)calloc((size_t)argc, sizeof(*files));
+    size_t filesCount  = 0;
+
+    if (!files)
+        return ERROR_NO_MEMORY;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stream") == 0)
+            options.stream = true;
+        else if (strcmp(argv[i], "--compact") == 0)
+            options.compact = true;
+        else if (strcmp(argv[i], "--aligned") == 0)
+            options.aligned = true;
+        else if (strcmp(argv[i], "--cache") == 0)
+            options.cache = true;
+        else if (strcmp(argv[i], "--object") == 0)
+            options.object = true;
+        else if (strcmp(argv[i], "--optimize") == 0)
+            options.optimize = true;
+        else if (strcmp(argv[i], "--fuse") == 0)
+        {
+            options.optimize = true;
+            options.fuse     = true;
+        }
+        else if (strcmp(argv[i], "--container") == 0)
+            options.container = true;
+        else if (strcmp(argv[i], "--link") == 0)
+            link = true;
+        else if (strcmp(argv[i], "--no-listing") == 0)
+            writeListing = false;
+        else if (strcmp(argv[i], "--stats=json") == 0)
+            options.stats = &stats;
+        else if (strncmp(argv[i], "--batch=", sizeof("--batch=") - 1) == 0)
+            manifestPath = argv[i] + sizeof("--batch=") - 1;
+        else if (strcmp(argv[i], "--jobs") == 0)
+            options.jobs = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+        else if (strncmp(argv[i], "--jobs=", sizeof("--jobs=") - 1) == 0)
+        {
+            char* jobsEnd = NULL;
+            options.jobs  = strtoul(argv[i] + sizeof("--jobs=") - 1, &jobsEnd, 10);
+
+            if (*jobsEnd != '\0' || options.jobs == 0)
+            {
+                fprintf(stderr, "Bad number of jobs %s.\n%s", argv[i], USAGE);
+                free(files);
+                return ERROR_BAD_VALUE;
+            }
+        }
+        else if (strncmp(argv[i], "--", 2) == 0)
+        {
+            fprintf(stderr, "Unknown option %s.\n%s", argv[i], USAGE);
+            free(files);
+            return ERROR_BAD_VALUE;
+        }
+        else
+            files[filesCount++] = argv[i];
+    }
+
+    ErrorCode error = EVERYTHING_FINE;
+
+    if (options.stats && (link || manifestPath))
+    {
+        fprintf(stderr, "Statistics are only collected for a single compilation.\n%s", USAGE);
+        error = ERROR_BAD_VALUE;
+    }
+    else if (options.stream && (options.object || options.optimize || options.container))
+    {
+        fprintf(stderr, "Stream mode only writes plain byte code.\n%s", USAGE);
+        error = ERROR_BAD_VALUE;
+    }
+    else if (link)
+    {
+        if (filesCount < 2 || manifestPath)
+        {
+            fprintf(stderr, "Please, give output and object files.\n%s", USAGE);
+            error = ERROR_BAD_FILE;
+        }
+        else
+        {
+            error = Link(files + 1, filesCount - 1, files[0], options.container, stdout);
+            if (error)
+                printf("LINK ERROR %s!!!\n", ERROR_CODE_NAMES[error]);
+        }
+    }
+    else if (manifestPath)
+    {
+        if (filesCount != 0)
+        {
+            fprintf(stderr, "Please, give either a manifest or input and output files.\n%s", USAGE);
+            error = ERROR_BAD_FILE;
+        }
+        else
+            error = CompileBatch(manifestPath, &options, writeListing);
+    }
+    else if (filesCount != 2)
+    {
+        fprintf(stderr, "Please, give input and output files.\n%s", USAGE);
+        error = ERROR_BAD_FILE;
+    }
+    else
     {
-        fprintf(stderr, "Please, give input and output files.\n");
+        error = _compileFile(files[0], files[1], &options, writeListing);
 
-        return ERROR_BAD_FILE;
+        if (!error && options.stats)
+            error = WriteCompileStatsJson(stdout, options.stats);
     }
 
-    const char* codeFilePath = argv[1];
-    const char* byteCodeFilePath = argv[2];
-    char* listingFilePath = (char*)calloc(strlen(byteCodeFilePath) + sizeof("_listing.txt"), 1);
-    strcpy(listingFilePath, byteCodeFilePath);
-    strcat(listingFilePath, "_listing.txt");
+    free(files);
+
+    return error;
+}
+
+static ErrorCode _compileFile(const char* codeFilePath, const char* byteCodeFilePath, const CompileOptions* options,
+                              bool writeListing)
+{
+    char* listingFilePath = NULL;
+    if (writeListing)
+    {
+        listingFilePath = CreateListingPath(byteCodeFilePath);
+        if (!listingFilePath)
+            return ERROR_NO_MEMORY;
+    }
 
-    ErrorCode compileError = Compile(codeFilePath, byteCodeFilePath, listingFilePath);
+    ErrorCode compileError = Compile(codeFilePath, byteCodeFilePath, listingFilePath, options);
 
     free(listingFilePath);
 
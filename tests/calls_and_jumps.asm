@@ -0,0 +1,125 @@
+; every conditional jump is taken once and falls through once, calls go to this object and to
+; calls_and_jumps_lib.asm which defines square, RAM is addressed directly and through registers
+push 0
+pop [0]
+push 3
+call square
+out
+push 4
+pop rbx
+push 7
+pop [rbx+1]
+push [5]
+call twice
+out
+
+push 1
+push 2
+ja fail
+push 2
+push 1
+ja ja_taken
+jmp fail
+ja_taken:
+push 1
+out
+
+push 1
+push 2
+jae fail
+push 2
+push 2
+jae jae_taken
+jmp fail
+jae_taken:
+push 2
+out
+
+push 2
+push 1
+jb fail
+push 1
+push 2
+jb jb_taken
+jmp fail
+jb_taken:
+push 3
+out
+
+push 2
+push 1
+jbe fail
+push 2
+push 2
+jbe jbe_taken
+jmp fail
+jbe_taken:
+push 4
+out
+
+push 1
+push 2
+je fail
+push 2
+push 2
+je je_taken
+jmp fail
+je_taken:
+push 5
+out
+
+push 2
+push 2
+jne fail
+push 1
+push 2
+jne jne_taken
+jmp fail
+jne_taken:
+push 6
+out
+
+; only fridays jump, both ways end up at the next command
+jf jf_done
+jf_done:
+
+; pushes of zero before ja and jne are fused into jaz and jnez
+push -1
+push 0
+ja fail
+push 1
+push 0
+ja jaz_taken
+jmp fail
+jaz_taken:
+push 0
+push 0
+jne fail
+push 1
+push 0
+jne jnez_taken
+jmp fail
+jnez_taken:
+push 7
+out
+
+push [0]
+out
+hlt
+
+fail:
+push -1
+out
+hlt
+
+; doubles the top of the stack, counting calls in [0] like square does
+twice:
+pop rcx
+push rcx
+push rcx
+add
+push [0]
+push 1
+add
+pop [0]
+ret
@@ -0,0 +1,11 @@
+; square for calls_and_jumps.asm, it counts its calls in [0]
+square:
+pop rdx
+push rdx
+push rdx
+mul
+push [0]
+push 1
+add
+pop [0]
+ret
@@ -0,0 +1,4 @@
+; a jump target past what a position can hold must stop the SPU instead of wrapping to 0
+push 1
+out
+jmp 1e30
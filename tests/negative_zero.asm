@@ -0,0 +1,13 @@
+; immediates are added to 0 when they are parsed, so "-0" is pushed as 0
+push -0
+out
+push -0.0
+out
+push rax+-0
+out
+; a computed negative zero keeps its sign
+push 0
+push -1
+mul
+out
+hlt
@@ -0,0 +1,42 @@
+; number words must give the bits the sscanf parser gave, the sums show the last bits
+push -0
+out
+push -0.0
+out
+push -.0
+out
+push 0.1
+push 0.2
+add
+push 0.3
+sub
+out
+push 9007199254740993
+push 9007199254740992
+sub
+out
+push 123456789012345678901234567890
+push 1.2345678901234568e29
+sub
+out
+push 2.2250738585072011e-308
+push 2.2250738585072014e-308
+sub
+out
+push 4.9e-324
+push 2.4703282292062328e-324
+sub
+out
+push 1e-400
+out
+push 1e400
+out
+push -1.5e3
+push 0x1.8p3
+add
+out
+push 1E22
+push 1e23
+div
+out
+hlt
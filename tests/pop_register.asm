@@ -0,0 +1,8 @@
+; a push and a pop of the same register cancel out
+push 5
+pop rax
+push rax
+pop rax
+push rax
+out
+hlt
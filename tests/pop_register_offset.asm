@@ -0,0 +1,6 @@
+; pop can't write to "rax+1", so the SPU must reject the program even when it is optimized
+push 7
+push rax+1
+pop rax+1
+out
+hlt
@@ -0,0 +1,12 @@
+; an addend keeps its immediate, so "rcx+2" pushes 5 and "[rbx+10]" reads cell 14
+push 3
+pop rcx
+push rcx+2
+out
+push 4
+pop rbx
+push 42
+pop [14]
+push [rbx+10]
+out
+hlt